@@ -1,5 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>  // pair
+#include <vector>
+
+class CConversionCache;
 
 namespace NaiSe {
 
@@ -9,18 +17,73 @@ struct BeatSetT;
 enum class Difficulty_t { easy, normal, hard, extra, special };
 
 
+/// Catalogue data of a beatmap.
+struct BeatmapInfoT
+{
+    std::string Artist;
+    std::string Title;
+    std::string Creator;
+    float AverageRate_bpm{};
+    float OverallDifficulty{};
+};
+
+
+/// Queue of one beatset and single-pass conversions. Instances share nothing, one per thread.
 class CBeatTranslator
 {
+    std::vector<BeatSetT> mMaps;  // queued by appendFile, consumed by translate
     bool mAvailableStages[5]{};
+    std::unique_ptr<CConversionCache> mpCache;
 
-    BeatSetT loadFile(const char* fullpath) const;
+    // Files changed while mapped end the process with SIGBUS, those of watched folders are read into memory
+    BeatSetT loadFile(const char* fullpath, bool useMapping=true) const;
+    bool readInfo(const char* fullpath, BeatmapInfoT& rOut, bool useMapping) const;
+    bool appendBeatset(BeatSetT&& data, Difficulty_t stage);
 
 public:
+    static const uint8_t MAX_STAGE_LEVEL = 9u;  // expert plus, single-pass stages run from 1 to it
+
+    CBeatTranslator();
+    ~CBeatTranslator();  // stores the cache
+    CBeatTranslator(const CBeatTranslator&) = delete;
+    CBeatTranslator& operator=(const CBeatTranslator&) = delete;
+
+    // Single-pass translations skip files converted before with equal content, stage and sequencer version,
+    // as long as the map file exists. Loads the cache from fullpath, nullptr or empty disables it.
+    bool setCache(const char* fullpath);
+
     // Generic Single-pass translation
     void convertFile(const char* fullpath, uint8_t stage=0u) const;
+    // Concurrent single-pass translation of independent files (path, stage); zero jobs uses all cores.
+    // Writes one index file per output folder holding staged maps. Repeated inputs, and inputs resolving to a map file
+    // another input writes, are skipped. Returns number of converted files.
+    size_t convertBatch(const std::vector<std::pair<std::string, uint8_t>>& files, unsigned jobs=0u) const;
+    // Single-pass translation of osu! content in memory, nothing is read from or written to disk.
+    // rOutName is the map file name (without extention) that rOutInfo refers to. Without stage there is no index,
+    // rOutInfo is left empty. Outputs are overwritten, returns false if the content can not be converted
+    // or the stage is above MAX_STAGE_LEVEL.
+    bool convertBuffer(std::string_view content, uint8_t stage, std::string& rOutMap, std::string& rOutInfo, std::string& rOutName) const;
+
+    // Reads metadata and timing only, hit objects are neither loaded nor parsed
+    bool readInfo(const char* fullpath, BeatmapInfoT& rOut) const;
+    // Finds the .osu files below a folder, or those matching a file name pattern with '*' and '?' below its folder.
+    // Files of equal artist, title and creator are translated as one beatset, ranked by overall difficulty.
+    // Groups run concurrently on 'jobs' threads, zero uses all cores. Returns number of converted files.
+    size_t convertTree(const char* pathOrPattern, unsigned jobs=1u) const;
+    // Converts the beatsets below a folder like convertTree, then waits for beatmaps written there. A changed map
+    // is translated on its own and the index of its set rewritten, the data of the other maps is kept from before.
+    // Sets are translated whole again only if ranks move. Map files of former stages and of deleted maps are removed.
+    // Returns when the folder can no longer be watched.
+    bool watchTree(const char* dir) const;
 
+    // False if the file can not be read or its stage is queued already
     bool appendFile(const char* fullpath, Difficulty_t stage);
-    void translate();
+    // Queues each beatmap of an .osz archive, read in memory. Ranks follow the hit object count,
+    // filling the stages not queued yet. Returns number of queued maps.
+    size_t appendArchive(const char* fullpath);
+    // Translates the queued difficulties concurrently on 'jobs' threads, zero uses all cores.
+    // Writes the index with the modes of all of them.
+    void translate(unsigned jobs=0u);
     void clear();
 };
 
@@ -1,6 +1,11 @@
 #include "Beatmap.h"
 
 #include <fstream>
+#include <algorithm>  // count
+#include <cstring>  // memmove
+
+#include "util/xstring.hpp"
+#include "util/xtrace.hpp"
 
 
 using namespace std;
@@ -9,31 +14,76 @@ using namespace std;
 CBeatmap::CBeatmap(const vector<string>& strLines, NaiSe::GameTypes_t game) :
 	mStrLines(strLines),
     mType(game)
-{}
+{
+    viewLines();
+}
 
 
 CBeatmap::CBeatmap(vector<string>&& strLines, NaiSe::GameTypes_t game) :
 	mStrLines(move(strLines)),
     mType(game)
-{}
+{
+    viewLines();
+}
 
 
-bool CBeatmap::initFromPath(const string& fullpath)
+void CBeatmap::viewLines()
 {
-	if (fullpath.empty())
-	{
-		return false;
-	}
+    mLines.assign(mStrLines.cbegin(), mStrLines.cend());
+}
 
-	ifstream fs(fullpath);
-	string strbuff;
 
-	if (!fs.is_open())
-	{
-		return false;
-	}
+namespace {
+
+const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+bool isStopLine(string_view lne, string_view stopTag)
+{
+    return !stopTag.empty() && (0 == xstring::trimView(lne).compare(0, stopTag.size(), stopTag));
+}
+
+// Cuts off commentary, false if nothing is left of the line
+bool filterCommentary(string_view& rLne)
+{
+    const size_t pos = rLne.find("//");
+    if (string_view::npos == pos)
+        return true;
+
+    rLne = rLne.substr(0, pos);
+    return pos > 0;
+}
+
+}// anonymous ns
+
 
-    mType = (string::npos != fullpath.rfind(".osu")) ? NaiSe::GameTypes_t::osu : NaiSe::GameTypes_t::unknown;
+// Same line and commentary handling as the stream reader, but without copies.
+void CBeatmap::splitLines(string_view content, string_view stopTag)
+{
+    size_t eol;
+    string_view lne;
+
+    mLines.clear();
+    mLines.reserve(count(content.cbegin(), content.cend(), '\n') + 1);
+    do
+    {
+        eol = content.find('\n');
+        lne = content.substr(0, eol);  // last line is taken as is, even if empty
+        content.remove_prefix((string_view::npos != eol) ? eol + 1 : content.size());
+        if (!lne.empty() && ('\r' == lne.back()))
+            lne.remove_suffix(1);
+        if (isStopLine(lne, stopTag))
+            break;
+
+        if (filterCommentary(lne))
+            mLines.push_back(lne);
+    } while (string_view::npos != eol);
+    xtrace::count("lines read", (int64_t)mLines.size());
+}
+
+
+void CBeatmap::setName(const string& fullpath)
+{
+    mType = xstring::endsWithNoCase(fullpath, ".osu") ? NaiSe::GameTypes_t::osu : NaiSe::GameTypes_t::unknown;
     size_t pos = fullpath.find_last_of("/\\") + 1;
     if (pos < fullpath.length())
     {
@@ -41,11 +91,78 @@ bool CBeatmap::initFromPath(const string& fullpath)
     } else {
         mFilename = fullpath;  // might end with slash
     }
-	
+}
+
+
+bool CBeatmap::initFromBuffer(vector<char>&& content, const string& fullpath)
+{
+    if (fullpath.empty() || content.empty())
+        return false;
+
+    mFile.close();
+    mStrLines.clear();
+    mBuffer = move(content);
+    setName(fullpath);
+    splitLines({ mBuffer.data(), mBuffer.size() });
+    return !mLines.empty();
+}
+
+
+bool CBeatmap::initFromView(string_view content, const string& fullpath)
+{
+    if (fullpath.empty() || content.empty())
+        return false;
+
+    mFile.close();
+    mStrLines.clear();
+    mBuffer.clear();
+    setName(fullpath);
+    splitLines(content);
+    return !mLines.empty();
+}
+
+
+bool CBeatmap::initFromPath(const string& fullpath, bool useMapping, string_view stopTag)
+{
+	if (fullpath.empty())
+	{
+		return false;
+	}
+
+    xtrace::CScope trace("initFromPath");
+    mFile.close();
+    if (useMapping && !mFile.open(fullpath))
+    {// fall back to stream reader
+        useMapping = false;
+    }
+
+	ifstream fs;
+	string strbuff;
+
+    if (!useMapping)
+    {
+        fs.open(fullpath);
+	    if (!fs.is_open())
+	    {
+		    return false;
+	    }
+    }
+
+    setName(fullpath);
 	mStrLines.clear();
+    mBuffer.clear();
+    if (useMapping)
+    {
+        splitLines(mFile.view(), stopTag);
+        return !mLines.empty();
+    }
+
+    size_t pos;
 	while (fs.good() && !fs.eof())
 	{
 		getline(fs, strbuff);  // note, beatsaber map is one line!
+        if (isStopLine(strbuff, stopTag))
+            break;
         pos = strbuff.find("//");  // filter commentary
         if (string::npos != pos)
         {
@@ -57,38 +174,124 @@ bool CBeatmap::initFromPath(const string& fullpath)
 		    mStrLines.push_back(move(strbuff));
         }
 	}
-    assert(fs.eof());  // nothing skipped
+    assert(fs.eof() || !stopTag.empty());  // nothing skipped
     fs.close();
+    viewLines();
+    xtrace::count("lines read", (int64_t)mLines.size());
 
 	return !mStrLines.empty();
 }
 
 
-bool CBeatmap::isValid() const
+bool CBeatmap::initFromStream(const string& fullpath, const function<bool(string_view)>& fLine, string_view stopTag)
 {
-    return !mStrLines.empty() && NaiSe::GameTypes_t::unknown != mType && !mFilename.empty();
+    if (fullpath.empty())
+        return false;
+
+    xtrace::CScope trace("initFromStream");
+    ifstream fs(fullpath, ios::binary);
+    if (!fs.is_open())
+        return false;
+
+    mFile.close();
+    mStrLines.clear();
+    mLines.clear();
+    setName(fullpath);
+
+    mBuffer.resize(STREAM_CHUNK_SIZE);
+    size_t kept{};  // begin of a line not ended within the chunk
+    int64_t lines{};
+    int64_t bytes{};
+    bool isDone{};
+    while (!isDone && fs.good())
+    {
+        if (kept == mBuffer.size())
+            mBuffer.resize(2 * mBuffer.size());  // line longer than a chunk
+
+        fs.read(mBuffer.data() + kept, mBuffer.size() - kept);
+        bytes += fs.gcount();
+        const bool isLast = !fs.good();
+        string_view content{ mBuffer.data(), kept + (size_t)fs.gcount() };
+        size_t eol;
+        string_view lne;
+        while (!isDone && !content.empty())
+        {
+            eol = content.find('\n');
+            if ((string_view::npos == eol) && !isLast)
+                break;  // completed by the next chunk
+
+            lne = content.substr(0, eol);
+            content.remove_prefix((string_view::npos != eol) ? eol + 1 : content.size());
+            if (!lne.empty() && ('\r' == lne.back()))
+                lne.remove_suffix(1);
+            if (isStopLine(lne, stopTag))
+            {
+                isDone = true;
+            } else if (filterCommentary(lne)) {
+                ++lines;
+                isDone = !fLine(lne);
+            }
+        }
+        kept = content.size();
+        memmove(mBuffer.data(), content.data(), kept);
+    }
+    mBuffer = vector<char>();
+    xtrace::count("lines read", lines);
+    xtrace::count("bytes read", bytes);
+    return lines > 0;
 }
 
 
-void CBeatmap::writeMap(string name)
+bool CBeatmap::isValid() const
 {
-    if (mStrLines.empty())
-        return;
+    return !mLines.empty() && NaiSe::GameTypes_t::unknown != mType && !mFilename.empty();
+}
+
 
+ofstream CBeatmap::openMap(string name, NaiSe::GameTypes_t game)
+{
     if (name.empty())
     {
         name = "newBeatmap";
     }
+    return ofstream(name + ((game == NaiSe::GameTypes_t::beatsaber) ? ".dat" : ".osu"));
+}
+
+
+bool CBeatmap::writeMap(string name, NaiSe::GameTypes_t game, string_view content)
+{
+    if (content.empty())
+        return false;
+
+    xtrace::CScope trace("writeMap");
+    auto fs = openMap(name, game);
+    if (!fs.is_open())
+        return false;
+
+    fs.write(content.data(), content.size());
+    fs << '\n';
+    xtrace::count("bytes written", (int64_t)content.size() + 1);
+    fs.close();
+    return !fs.fail();
+}
+
+
+void CBeatmap::writeMap(string name)
+{
+    if (mLines.empty())
+        return;
 
-    ofstream fs(name + ((mType == NaiSe::GameTypes_t::beatsaber) ? ".dat" : ".osu"));
+    xtrace::CScope trace("writeMap");
+    auto fs = openMap(name, mType);
 
     if (!fs.is_open())
         return;
 
-    for (auto lneIt=mStrLines.cbegin(); lneIt!=mStrLines.cend(); ++lneIt)
+    for (auto lneIt=mLines.cbegin(); lneIt!=mLines.cend(); ++lneIt)
     {
         fs << *lneIt << '\n';
     }
+    xtrace::count("bytes written", (int64_t)fs.tellp());
     fs.flush();
     fs.close();
 }
@@ -1,27 +1,47 @@
 #pragma once
 
+#include <fstream>
+#include <functional>
+#include <string_view>
+
 #include "common.hpp"
+#include "util/xfile.hpp"
 
 
 /// File handler and string reader.
 class CBeatmap
 {
 	std::vector<std::string> mStrLines;
+    std::vector<std::string_view> mLines;  // views into mStrLines, mBuffer or the mapped file
+    std::vector<char> mBuffer;  // moves keep the storage, unlike short strings
+    xfile::CMappedFile mFile;
     NaiSe::GameTypes_t mType{NaiSe::GameTypes_t::unknown};
 	std::string mFilename;
 
+    void splitLines(std::string_view content, std::string_view stopTag={});
+    void viewLines();
+    void setName(const std::string& fullpath);
+
 public:
     CBeatmap() = default;
     CBeatmap(const std::vector<std::string>& strLines, NaiSe::GameTypes_t game);
     CBeatmap(std::vector<std::string>&& strLines, NaiSe::GameTypes_t game);
+    CBeatmap(const CBeatmap&) = delete;  // views would dangle
+    CBeatmap(CBeatmap&&) = default;
 
     NaiSe::GameTypes_t getGameType() const { return mType; }
     std::string getFilename() const { return mFilename; }
-    NaiSe::StringSequenceT getSequence() const { return { mStrLines.cbegin(), mStrLines.cend(), mStrLines.size() }; }
+    NaiSe::StringSequenceT getSequence() const { return { mLines.cbegin(), mLines.cend(), mLines.size() }; }
     
 
-	bool initFromPath(const std::string& fullpath);
+	bool initFromPath(const std::string& fullpath, bool useMapping=false, std::string_view stopTag={});  // mapped lines stay valid until re-init, stopTag ends reading
+    bool initFromBuffer(std::vector<char>&& content, const std::string& fullpath);  // fullpath gives name and type only
+    bool initFromView(std::string_view content, const std::string& fullpath);  // content must outlive the lines
+    // Reads fixed-size chunks and hands each line, commentary removed, to fLine without keeping it. Lines longer
+    // than a chunk grow the buffer. Ends at stopTag or when fLine returns false. Only name and type remain afterwards.
+    bool initFromStream(const std::string& fullpath, const std::function<bool(std::string_view)>& fLine, std::string_view stopTag={});
     void writeMap(std::string name);  // without extention
+    static bool writeMap(std::string name, NaiSe::GameTypes_t game, std::string_view content);  // single line, no copy, false if not written
+    static std::ofstream openMap(std::string name, NaiSe::GameTypes_t game);  // for writing piece by piece, extention added like writeMap
     bool isValid() const;
 };
-
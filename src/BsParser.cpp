@@ -0,0 +1,208 @@
+#include "BsParser.h"
+
+#include <filesystem>
+
+#include "common.hpp"
+#include "util/xfile.hpp"
+#include "util/xjson.hpp"
+#include "util/xtrace.hpp"
+
+
+using namespace std;
+using namespace NaiSe;
+
+
+namespace {
+
+// Same names as the sequencer writes
+const char* const STAGE_NAMES[] = { "Easy", "Normal", "Hard", "Expert", "ExpertPlus" };
+const pair<string_view, GameMode_t> MODE_NAMES[] = {
+    { "NoArrows", GameMode_t::bs_2H_free },
+    { "Standard", GameMode_t::bs_2H },
+    { "OneSaber", GameMode_t::bs_1H }
+};
+
+bool readEvent(xjson::CReader& rd, EventT& rOut)
+{
+    int type{-1};
+    string_view key;
+    if (!rd.beginObject())
+        return false;
+
+    while (rd.nextKey(key))
+    {
+        if ("_time" == key)
+            rd.read(rOut.Timestamp);
+        else if ("_type" == key)
+            rd.read(type);
+        else if ("_value" == key)
+            rd.read(rOut.Value);
+        else
+            rd.skipValue();
+    }
+    rOut.EventType = static_cast<EventType_t>(type);
+    return rd.isOk();
+}
+
+bool readNote(xjson::CReader& rd, EntityT& rOut)
+{
+    string_view key;
+    if (!rd.beginObject())
+        return false;
+
+    while (rd.nextKey(key))
+    {
+        if ("_time" == key)
+            rd.read(rOut.SpawnTime);
+        else if ("_lineIndex" == key)
+            rd.read(rOut.Location.first);
+        else if ("_lineLayer" == key)
+            rd.read(rOut.Location.second);
+        else if ("_type" == key)
+            rd.read(rOut.Type.RawType);
+        else if ("_cutDirection" == key)
+            rd.read(rOut.Value);
+        else
+            rd.skipValue();
+    }
+    return rd.isOk();
+}
+
+bool readObstacle(xjson::CReader& rd, EntityT& rOut)
+{
+    string_view key;
+    if (!rd.beginObject())
+        return false;
+
+    while (rd.nextKey(key))
+    {
+        if ("_time" == key)
+            rd.read(rOut.SpawnTime);
+        else if ("_lineIndex" == key)
+            rd.read(rOut.Location.first);
+        else if ("_type" == key)
+            rd.read(rOut.Type.RawType);
+        else if ("_duration" == key)
+            rd.read(rOut.Value);
+        else if ("_width" == key)
+            rd.read(rOut.Location.second);
+        else
+            rd.skipValue();
+    }
+    return rd.isOk();
+}
+
+template<typename T>
+bool readArray(xjson::CReader& rd, vector<T>& rOut, bool (*fRead)(xjson::CReader&, T&))
+{
+    if (!rd.beginArray())
+        return false;
+
+    while (rd.nextItem())
+    {
+        rOut.emplace_back();
+        if (!fRead(rd, rOut.back()))
+            return false;
+    }
+    return rd.isOk();
+}
+
+}// anonymous ns
+
+
+bool CBsParser::tryParse(string_view json, BeatSetT& rOut)
+{
+    xtrace::CScope trace("tryParse dat");
+    xjson::CReader rd(json);
+    string_view key;
+    bool hasNotes{};
+    if (!rd.beginObject())
+        return false;
+
+    while (rd.nextKey(key))
+    {
+        if ("_events" == key)
+        {
+            readArray(rd, rOut.Events, readEvent);
+        } else if ("_notes" == key) {
+            hasNotes = readArray(rd, rOut.Targets, readNote);
+        } else if ("_obstacles" == key) {
+            readArray(rd, rOut.Objects, readObstacle);
+        } else {
+            rd.skipValue();  // version, custom data and later additions
+        }
+    }
+    if (!rd.isOk() || !hasNotes)
+        return false;
+
+    rOut.Game = GameTypes_t::beatsaber;
+    xtrace::count("objects parsed", (int64_t)(rOut.Targets.size() + rOut.Objects.size()));
+    return true;
+}
+
+
+bool CBsParser::tryParseInfo(string_view json, MediaInfoT& rOut)
+{
+    xjson::CReader rd(json);
+    string_view key;
+    string_view str;
+    float preview_s{};
+    if (!rd.beginObject())
+        return false;
+
+    while (rd.nextKey(key))
+    {
+        if ("_songName" == key)
+        {
+            if (rd.read(str))
+                rOut.Title = xjson::unescape(str);
+        } else if ("_songAuthorName" == key) {
+            if (rd.read(str))
+                rOut.Artist = xjson::unescape(str);
+        } else if ("_levelAuthorName" == key) {
+            if (rd.read(str))
+                rOut.Author = xjson::unescape(str);
+        } else if ("_songFilename" == key) {
+            if (rd.read(str))
+                rOut.Filename = xjson::unescape(str);
+        } else if ("_beatsPerMinute" == key) {
+            rd.read(rOut.AverageRate_bpm);
+        } else if ("_previewStartTime" == key) {
+            if (rd.read(preview_s))
+                rOut.PreviewStart_ms = (uint32_t)max(0.f, preview_s * 1000.f);
+        } else {
+            rd.skipValue();
+        }
+    }
+    return rd.isOk() && (rOut.AverageRate_bpm > 0);
+}
+
+
+bool CBsParser::tryParseFile(const string& fullpath, BeatSetT& rOut)
+{
+    namespace stdfs = std::filesystem;
+
+    xfile::CMappedFile file;
+    if (!file.open(fullpath) || !tryParse(file.view(), rOut))
+        return false;
+
+    const stdfs::path path(fullpath);
+    rOut.Setting.MapName = path.stem().string();
+    for (auto&& mode : MODE_NAMES)
+    {
+        if (0 == rOut.Setting.MapName.compare(0, mode.first.size(), mode.first))
+        {
+            rOut.Setting.Mode = mode.second;
+            const auto stage = string_view(rOut.Setting.MapName).substr(mode.first.size());
+            for (size_t i=0; i<size(STAGE_NAMES); ++i)
+            {
+                if (STAGE_NAMES[i] == stage)
+                    rOut.StageLevel = (uint8_t)(2 * i + 1);
+            }
+            break;
+        }
+    }
+
+    // Names the output folder and holds the rate, a map alone can not be stored again
+    return file.open((path.parent_path() / "Info.dat").string()) && tryParseInfo(file.view(), rOut.Media);
+}
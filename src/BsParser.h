@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace NaiSe{
+struct BeatSetT;
+struct MediaInfoT;
+}
+
+
+class CBsParser
+{
+public:
+    // Beat Saber v2 difficulty JSON, as written by CBsSequencer. Fills events, notes and obstacles,
+    // unknown keys like _customData are skipped. Timestamps stay in beats.
+    static bool tryParse(std::string_view json, NaiSe::BeatSetT& rOut);
+    // Song details of an Info.dat
+    static bool tryParseInfo(std::string_view json, NaiSe::MediaInfoT& rOut);
+    // Difficulty file with the Info.dat of its folder, false if that is missing. Mode and stage follow the file name.
+    static bool tryParseFile(const std::string& fullpath, NaiSe::BeatSetT& rOut);
+};
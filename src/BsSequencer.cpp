@@ -1,12 +1,16 @@
 #include "BsSequencer.h"
 
 #include <algorithm>
-#include <functional>  //function
-#include <forward_list>
+#include <array>
+#include <charconv>  // to_chars
+#include <cstring>  // memcpy
+#include <functional>
 #include <iterator> // distance
 #include <sstream>
 
 #include "common.hpp"
+#include "util/xmemory.hpp"
+#include "util/xtrace.hpp"
 
 
 using namespace std;
@@ -29,10 +33,10 @@ namespace NaiSe {
     const char* const STAGE_NAMES[] = { "Easy", "Normal", "Hard", "Expert", "ExpertPlus" };
     const char MODE_NAME_NA[] = "NoArrows";
     const char MODE_NAME_NM[] = "Standard";
+    const char MODE_NAME_OS[] = "OneSaber";
     const uint16_t LEAD_IN_TIME_MS = 3000;
 
 }// NaiSe ns
-ostream& operator<< (ostream& lhs, const EventType_t& rhs) { return (lhs << enum_cast(rhs)); }
 float& operator<< (float& lhs, const Switch_t& rhs) { return (lhs = static_cast<uint8_t>(rhs)); }
 uint8_t& operator<< (uint8_t& lhs, const Cube_t& rhs) { return (lhs = static_cast<uint8_t>(rhs)); }
 
@@ -48,28 +52,100 @@ const float BLOCK_PLACEMENT_DOWNTIME_NEIGHBOUR_MS = 125.f;
 const auto OS_COL_SZ = (float)Os_Map_Width / 4;  
 const auto OS_ROW_SZ = (float)Os_Map_Height / 3;
 const uint16_t BS_MAX_BPM = 300u;
+const double GRID_TOLERANCE_MS = 1.0;  // timestamps are whole ms, grid points are not
 
-float quantizeTimestamp(float ts, double period, const uint8_t MAX_DENUM=8)
+/// Snaps a timestamp in ms down to 1/TDenum beat of the timing segment it falls in, found by binary search.
+/// Ticks count grid steps over all segments and grow with time. Beats count 'base' periods from zero,
+/// the single rate of the map info.
+template<uint8_t TDenum>
+class Quantizer
 {
-    if (ts == 0 || period == 0)
-        return 0;
-
-    period = abs(ts / period);
-    ts = (float)(period - floor(period));  // fraction, never 1
-    period = floor(period);  // whole
-    float div;
-    for (int i=2; i<=MAX_DENUM; i=i<<1)
+    static_assert(TDenum && !(TDenum & (TDenum - 1)), "Denominator must be a power of two");
+
+    struct SegmentT
+    {
+        double Start_ms;
+        double Period_ms;
+        tick_t FirstTick;
+    };
+
+    pmr::vector<SegmentT> mSegments;
+    double mBase;
+
+public:
+    static constexpr uint8_t TICKS_PER_BEAT = TDenum;
+
+    // Without timing, a single segment of the base period starts at zero
+    Quantizer(const vector<TimingT>& timing, double base) :
+        mSegments(xmemory::CScratchScope::scratch()),
+        mBase(base)
     {
-        div = 1.f / i;
-        if (ts >= div)
+        mSegments.reserve(max<size_t>(1, timing.size()));
+        for (auto&& ti : timing)
         {
-            ts -= div;
-            period += div;  // add quant
+            if (ti.Period_ms <= 0)
+                continue;
+
+            if (mSegments.empty())
+            {// the first segment reaches back to zero
+                const double beatsBefore = ceil(ti.Start_ms / ti.Period_ms);
+                mSegments.push_back({ ti.Start_ms - max(0., beatsBefore) * ti.Period_ms, ti.Period_ms, 0 });
+                continue;
+            }
+            const auto& last = mSegments.back();
+            if (ti.Start_ms <= last.Start_ms)
+                continue;  // unsorted
+
+            const auto span = (tick_t)ceil((ti.Start_ms - last.Start_ms) / last.Period_ms * TDenum);
+            mSegments.push_back({ ti.Start_ms, ti.Period_ms, last.FirstTick + span });
         }
-        if (ts < 0.125)
-            break;
+        if (mSegments.empty())
+            mSegments.push_back({ 0., base, 0 });
+    }
+
+    tick_t toTicks(float ts) const
+    {
+        auto it = upper_bound(mSegments.cbegin(), mSegments.cend(), ts + GRID_TOLERANCE_MS,
+            [](double t, const SegmentT& seg) { return t < seg.Start_ms; });
+        if (it != mSegments.cbegin())
+            --it;
+        return it->FirstTick + (tick_t)floor((ts - it->Start_ms + GRID_TOLERANCE_MS) / it->Period_ms * TDenum);
+    }
+
+    float toBeats(tick_t ticks) const
+    {
+        auto it = upper_bound(mSegments.cbegin(), mSegments.cend(), ticks,
+            [](tick_t t, const SegmentT& seg) { return t < seg.FirstTick; });
+        if (it != mSegments.cbegin())
+            --it;
+        return (float)((it->Start_ms + (double)(ticks - it->FirstTick) * it->Period_ms / TDenum) / mBase);
+    }
+
+    float operator()(float ts) const { return toBeats(toTicks(ts)); }
+};
+
+// Calls fTransform with the quantizer matching the ticks per beat of the subgrid size.
+template<typename TFunc>
+void withQuantizer(uint8_t subgridSize, const vector<TimingT>& timing, double base, TFunc&& fTransform)
+{
+    switch (ticksPerBeat(subgridSize))
+    {
+    case 8:
+        fTransform(Quantizer<8>(timing, base));
+        break;
+
+    case 4:
+        fTransform(Quantizer<4>(timing, base));
+        break;
+
+    case 2:
+        fTransform(Quantizer<2>(timing, base));
+        break;
+
+    default:
+        fTransform(Quantizer<1>(timing, base));
+        break;
     }
-    return (float)period;
 }
 
 float setSpeedByPeriod(float tDelta_ms)
@@ -77,19 +153,115 @@ float setSpeedByPeriod(float tDelta_ms)
     return floor(max(1.f, min(7.f, 1400.f/abs(tDelta_ms))));
 }
 
-void ss_appendEvent(stringstream& rOut, const NaiSe::EventT& ev)
+// Worst case lengths of formatted numbers
+const size_t BF_FLOAT_MAX = 16;  // "-1.23457e+38", same format as ostream default
+const size_t BF_INT_MAX = 11;  // "-2147483648"
+
+// Worst case lengths of formatted records including separator
+const size_t BF_EVENT_MAX = 30 + BF_FLOAT_MAX + 2 * BF_INT_MAX;
+const size_t BF_TARGET_MAX = 65 + BF_FLOAT_MAX + 4 * BF_INT_MAX;
+const size_t BF_OBJECT_MAX = 57 + 2 * BF_FLOAT_MAX + 3 * BF_INT_MAX;
+const size_t BF_HEADER_MAX = 64;
+
+template<size_t N>
+char* bf_put(char* pOut, const char (&str)[N])
+{
+    memcpy(pOut, str, N - 1);
+    return pOut + N - 1;
+}
+
+char* bf_put(char* pOut, const char* str)
+{
+    const auto len = strlen(str);
+    memcpy(pOut, str, len);
+    return pOut + len;
+}
+
+char* bf_put(char* pOut, char c)
+{
+    *pOut = c;
+    return pOut + 1;
+}
+
+char* bf_put(char* pOut, float val)
+{
+    return to_chars(pOut, pOut + BF_FLOAT_MAX, val, chars_format::general, 6).ptr;
+}
+
+char* bf_put(char* pOut, int val)
+{
+    return to_chars(pOut, pOut + BF_INT_MAX, val).ptr;
+}
+
+char* bf_appendEvent(char* pOut, const NaiSe::EventT& ev)
 {
-    rOut << "{\"_time\":" << ev.Timestamp << ",\"_type\":" << ev.EventType << ",\"_value\":" << (int)ev.Value << '}';
+    pOut = bf_put(pOut, "{\"_time\":");
+    pOut = bf_put(pOut, ev.Timestamp);
+    pOut = bf_put(pOut, ",\"_type\":");
+    pOut = bf_put(pOut, (int)enum_cast(ev.EventType));
+    pOut = bf_put(pOut, ",\"_value\":");
+    pOut = bf_put(pOut, (int)ev.Value);
+    return bf_put(pOut, '}');
 }
 
-void ss_appendTarget(stringstream& rOut, const NaiSe::EntityT& tar)
+char* bf_appendTarget(char* pOut, const NaiSe::EntityT& tar)
 {
-    rOut << "{\"_time\":" << tar.SpawnTime << ",\"_lineIndex\":" << tar.Location.first << ",\"_lineLayer\":" << tar.Location.second << ",\"_type\":" << (int)tar.Type.RawType << ",\"_cutDirection\":" << (int)tar.Value << '}';
+    pOut = bf_put(pOut, "{\"_time\":");
+    pOut = bf_put(pOut, tar.SpawnTime);
+    pOut = bf_put(pOut, ",\"_lineIndex\":");
+    pOut = bf_put(pOut, (int)tar.Location.first);
+    pOut = bf_put(pOut, ",\"_lineLayer\":");
+    pOut = bf_put(pOut, (int)tar.Location.second);
+    pOut = bf_put(pOut, ",\"_type\":");
+    pOut = bf_put(pOut, (int)tar.Type.RawType);
+    pOut = bf_put(pOut, ",\"_cutDirection\":");
+    pOut = bf_put(pOut, (int)tar.Value);
+    return bf_put(pOut, '}');
 }
 
-void ss_appendObject(stringstream& rOut, const NaiSe::EntityT& obj)
+char* bf_appendObject(char* pOut, const NaiSe::EntityT& obj)
 {
-    rOut << "{\"_time\":" << obj.SpawnTime << ",\"_lineIndex\":" << obj.Location.first << ",\"_type\":" << (int)obj.Type.RawType << ",\"_duration\":" << obj.Value << ",\"_width\":" << obj.Location.second << '}';
+    pOut = bf_put(pOut, "{\"_time\":");
+    pOut = bf_put(pOut, obj.SpawnTime);
+    pOut = bf_put(pOut, ",\"_lineIndex\":");
+    pOut = bf_put(pOut, (int)obj.Location.first);
+    pOut = bf_put(pOut, ",\"_type\":");
+    pOut = bf_put(pOut, (int)obj.Type.RawType);
+    pOut = bf_put(pOut, ",\"_duration\":");
+    pOut = bf_put(pOut, obj.Value);
+    pOut = bf_put(pOut, ",\"_width\":");
+    pOut = bf_put(pOut, (int)obj.Location.second);
+    return bf_put(pOut, '}');
+}
+
+template<typename T>
+char* bf_appendArray(char* pOut, const vector<T>& items, char* (*fAppend)(char*, const T&))
+{
+    pOut = bf_put(pOut, '[');
+    for (auto it=items.cbegin(); it!=items.cend(); ++it)
+    {
+        if (it != items.cbegin())
+            pOut = bf_put(pOut, ',');
+        pOut = fAppend(pOut, *it);
+    }
+    return bf_put(pOut, ']');
+}
+
+// Appends items to an array opened before, each but the first of the array behind a comma
+template<typename TItems, typename T>
+void bf_appendItems(string& rOut, const TItems& items, char* (*fAppend)(char*, const T&), size_t itemMax, bool& rIsFirst)
+{
+    const size_t len = rOut.size();
+    rOut.resize(len + items.size() * itemMax);  // sized for the worst case, like serializeBeatset
+    char* pOut = rOut.data() + len;
+    for (auto&& item : items)
+    {
+        if (!rIsFirst)
+            pOut = bf_put(pOut, ',');
+        rIsFirst = false;
+        pOut = fAppend(pOut, item);
+    }
+    rOut.resize(pOut - rOut.data());
 }
 
 void ss_appendStage(
@@ -107,7 +279,7 @@ void ss_appendStage(
 }
 
 // Returns iterator to last element in a sweep pattern, 'end' if pattern is not fullfilled.
-vector<EntityT>::const_iterator isSweepPattern(vector<EntityT>::const_iterator it, vector<EntityT>::const_iterator end, double tTolerance_ms)
+const EntityT* isSweepPattern(const EntityT* it, const EntityT* end, double tTolerance_ms)
 {
     if (it==end)
         return end;
@@ -149,6 +321,29 @@ vector<EntityT>::const_iterator isSweepPattern(vector<EntityT>::const_iterator i
     return (i>=4) ? it : end;
 }
 
+// Begin of the last n timelines (runs of equal timestamp) of a range in time order, pFirst if it has fewer
+const EntityT* findLastTimelines(const EntityT* pFirst, const EntityT* pLast, size_t n)
+{
+    size_t cnt{};
+    const EntityT* it = pLast;
+    while (it != pFirst)
+    {
+        if ((it == pLast) || ((it - 1)->SpawnTime < it->SpawnTime))
+        {// it - 1 ends a timeline
+            if (n == cnt)
+                break;
+            ++cnt;
+        }
+        --it;
+    }
+    return it;
+}
+
+bool isAfterLeadIn(const EntityT& en)
+{
+    return en.SpawnTime > LEAD_IN_TIME_MS;
+}
+
 template<const char* TSetName>
 void ss_appendSet(stringstream& sstr, CBsSequencer::BsStageFlagsT stages)
 {
@@ -191,19 +386,37 @@ void ss_appendSet(stringstream& sstr, CBsSequencer::BsStageFlagsT stages)
     sstr << "]}";
 }
 
+bool isEventBefore(const EventT& evn, const EventT& other)
+{
+    return evn.Timestamp < other.Timestamp;
+}
+
+// Insertion sort, O(n) for runs generated (nearly) in order of time.
+// Places each event in front of earlier added ones with equal timestamp.
+void sortEventRun(pmr::vector<EventT>& rInOut)
+{
+    for (auto it=rInOut.begin(); it!=rInOut.end(); ++it)
+    {
+        if ((it == rInOut.begin()) || isEventBefore(*prev(it), *it))
+            continue;  // already in order
+
+        rotate(lower_bound(rInOut.begin(), it, *it, isEventBefore), it, next(it));
+    }
+}
+
 }// anonymous ns
 
 
+template<typename TSampler>
 void processEvents(
     const vector<EventT>&  rInEvents,
-    forward_list<EventT>&  rOutEvents,
+    pmr::vector<EventT>&   rOutEvents,
     uint16_t               tLeadIn_ms,
     uint16_t               tStart_ms,
-    function<float(float)> fSetSample)
+    const TSampler&        fSetSample)
 {
     //using BsSw_t = CBsSequencer::Switch_t;
 
-    assert(fSetSample);
     if (tStart_ms < tLeadIn_ms)
         swap(tStart_ms, tLeadIn_ms);
 
@@ -222,7 +435,7 @@ void processEvents(
     for (auto&& li : lights)
     {
         evn.EventType = li;
-        rOutEvents.push_front(evn);
+        rOutEvents.push_back(evn);
     }
 
     // __ Events __
@@ -235,13 +448,13 @@ void processEvents(
     evn.EventType = lights[0];
     evn.Timestamp = max(3.f, fSetSample(tLeadIn_ms));
     evn.Value << Switch_t::s1_on;
-    rOutEvents.push_front(evn);
+    rOutEvents.push_back(evn);
 
     // Turn on environment light at start time
     evn.Timestamp = max(3.f , fSetSample(tStart_ms));
     evn.Value << Switch_t::s1_on;
     evn.EventType = lights[1];
-    rOutEvents.push_front(evn);
+    rOutEvents.push_back(evn);
     
     // Create speed change and key events
     for (auto&& evi : rInEvents)
@@ -254,7 +467,7 @@ void processEvents(
             {// TODO test this part on speed change
                 evn.EventType = EventType_t::set_laserLsSpd;
                 evn.Value = setSpeedByPeriod(evi.Value);
-                rOutEvents.push_front(evn);
+                rOutEvents.push_back(evn);
 
                 evn.EventType = EventType_t::set_laserRsSpd;
 
@@ -262,17 +475,17 @@ void processEvents(
             } else {  // kiai off
                 evn.Value << Switch_t::s2_fl_off;
                 evn.EventType = EventType_t::sw_laserLs;
-                rOutEvents.push_front(evn);
+                rOutEvents.push_back(evn);
 
                 evn.EventType = EventType_t::sw_laserRs;
-                rOutEvents.push_front(evn);
+                rOutEvents.push_back(evn);
 
                 evn.EventType = EventType_t::sw_lightLo;
-                rOutEvents.push_front(evn);
+                rOutEvents.push_back(evn);
 
                 evn.EventType = EventType_t::sw_lightBg;
                 evn.Value << Switch_t::s1_on;
-                rOutEvents.push_front(evn);
+                rOutEvents.push_back(evn);
 
                 evn.EventType = EventType_t::ringMov;
                 evn.Value = RING_MOV_TOGG_VAL;
@@ -282,17 +495,17 @@ void processEvents(
         case EventType_t::kiai:
             evn.EventType = EventType_t::sw_lightBg;
             evn.Value << Switch_t::s_Off;
-            rOutEvents.push_front(evn);
+            rOutEvents.push_back(evn);
 
             evn.Value << Switch_t::s2_on;
             evn.EventType = EventType_t::sw_laserLs;
-            rOutEvents.push_front(evn);
+            rOutEvents.push_back(evn);
 
             evn.EventType = EventType_t::sw_laserRs;
-            rOutEvents.push_front(evn);
+            rOutEvents.push_back(evn);
 
             evn.EventType = EventType_t::sw_lightLo;
-            rOutEvents.push_front(evn);
+            rOutEvents.push_back(evn);
 
             evn.EventType = EventType_t::ringMov;
             evn.Value = RING_MOV_TOGG_VAL;
@@ -303,274 +516,186 @@ void processEvents(
             evn.Value = 0;
             break;
         }
-        rOutEvents.push_front(evn);
+        rOutEvents.push_back(evn);
     }
 }
 
 
-void transform_mania(
-    BeatSetT&              rInOut,
-    const double           baseTime_ms,
-    forward_list<EventT>&  evList,
-    function<float(float)> ftRelative,
-    GameMode_t             mode=GameMode_t::bs_2H_free)
-{
-    assert(ftRelative);
-    //if (GameTypes_t::beatsaber == rInOut.Game)
-    //    return;
-
-    //assert(GameTypes_t::osu == rInOut.Game);
-    assert(GameMode_t::os_mania == rInOut.Setting.Mode);
-    //assert(gameMode == CBsSequencer::BsModeFlagsT::FREESTYLE ||
-    //    gameMode == CBsSequencer::BsModeFlagsT::SUPPORTED);
-
-    //const auto colSz = (float)Os_Map_Width / 4;  
-    //const auto rowSz = (float)Os_Map_Height / 3;
-    //const double baseTime_ms = 60000.f / max(rInOut.Media.AverageRate_bpm, 1.f);
+namespace {
 
-    /*
-    EventT evn;
-    forward_list<EventT> evList;
-    // Switch off all lights at start
-    const EventType_t lights[] = {
-        EventType_t::sw_lightBg,
-        EventType_t::sw_lightSd,
-        EventType_t::sw_laserLs,
-        EventType_t::sw_laserRs,
-        EventType_t::sw_lightLo
-    };
-    for (auto&& li : lights)
-    {
-        evn.EventType = li;
-        evList.push_front(evn);
-    }
+/// Color changes of the environment light, one on each combo start. Fed the targets from the first one after
+/// lead-in on, which turns the light on if it starts no combo.
+template<typename TSampler>
+class ComboEvents
+{
+    const TSampler& mfSample;
+    bool mIsStarted{};
+    bool mIsBlue{true};
 
-    evn.EventType = lights[0];
-    evn.Timestamp = max(4.f, quantizeTimestamp(rInOut.Setting.LeadIn_ms, baseTime_ms, rInOut.Setting.SubgridSize));
-    evn.Value = (float)Switch_t::s1_on;
-    evList.push_front(evn);
+public:
+    explicit ComboEvents(const TSampler& fSample) : mfSample(fSample) {}
 
-    // Create speed change and key events
-    float tVal{};
-    for (auto&& evi : rInOut.Events)
+    void feed(const EntityT* pFirst, const EntityT* pLast, pmr::vector<EventT>& rOut)
     {
-        evn.Timestamp = quantizeTimestamp(evi.Timestamp, baseTime_ms, rInOut.Setting.SubgridSize);
-        switch (evi.EventType)
+        if (!mIsStarted && (pFirst != pLast))
         {
-        case EventType_t::shift:
-            if (FLT_EPSILON < abs(tVal - evi.Value))  // bpm change
-            {// TODO test this part on speed change
-                evn.EventType = EventType_t::set_laserLsSpd;
-                evn.Value = setSpeedByPeriod(evi.Value);
-                evList.push_front(evn);
-
-                evn.EventType = EventType_t::set_laserRsSpd;
-
-                tVal = evi.Value;
-            } else {  // kiai off
-                evn.Value = (float)Switch_t::s2_fl_off;
-                evn.EventType = EventType_t::sw_laserLs;
-                evList.push_front(evn);
-
-                evn.EventType = EventType_t::sw_laserRs;
-                evList.push_front(evn);
-
-                evn.EventType = EventType_t::sw_lightLo;
-                evList.push_front(evn);
-
-                evn.EventType = EventType_t::sw_lightBg;
-                evn.Value = (float)Switch_t::s1_on;
-                evList.push_front(evn);
-
-                evn.EventType = EventType_t::ringMov;
-                evn.Value = RING_MOV_TOGG_VAL;
+            mIsStarted = true;
+            if (!pFirst->Type.OsuType.IsComboStart)
+            {
+                rOut.emplace_back(
+                    EventT{
+                        EventType_t::sw_lightSd,
+                        mfSample(pFirst->SpawnTime),
+                        (float)enum_cast(Switch_t::s1_on)
+                    });
             }
-            break;
-
-        case EventType_t::kiai:
-            evn.EventType = EventType_t::sw_lightBg;
-            evn.Value = (float)Switch_t::s_Off;
-            evList.push_front(evn);
-
-            evn.Value = (float)Switch_t::s2_on;
-            evn.EventType = EventType_t::sw_laserLs;
-            evList.push_front(evn);
-
-            evn.EventType = EventType_t::sw_laserRs;
-            evList.push_front(evn);
+        }
+        for (; pFirst!=pLast; ++pFirst)
+        {
+            if (!pFirst->Type.OsuType.IsComboStart)
+                continue;
 
-            evn.EventType = EventType_t::sw_lightLo;
-            evList.push_front(evn);
+            rOut.emplace_back(
+                EventT{
+                    EventType_t::sw_lightSd,
+                    mfSample(pFirst->SpawnTime),
+                    (float)enum_cast(mIsBlue ? Switch_t::s2_on : Switch_t::s1_on)
+                });
+            mIsBlue = !mIsBlue;  // toggle color
+        }
+    }
+};
 
-            evn.EventType = EventType_t::ringMov;
-            evn.Value = RING_MOV_TOGG_VAL;
-            break;
 
-        default:
-            evn.EventType = EventType_t::ringRot;
-            evn.Value = 0;
-            break;
+/// Places mania targets on four lanes, with walls along holds and beside sweeps. Fed in time order, targets
+/// are placed once a sweep starting there can no longer reach past the fed ones, and handed out by line of equal tick.
+template<typename TSampler>
+class ManiaTransform
+{
+    const TSampler& mfSample;
+    const double mBase_ms;
+    vector<EntityT> mAhead;  // fed, not placed yet
+    pmr::vector<EntityT> mLine{xmemory::CScratchScope::scratch()};  // placed, sides not assigned yet
+    tick_t mLineTick{};
+    tick_t mLastTick{};
+    float mTimeSlots[4][3] = {};  // 4:x, 3:y
+    float mtWall{};  // earliest start of the next sweep wall
+    bool mIsLeft{true};
+
+public:
+    ManiaTransform(const TSampler& fSample, double baseTime_ms) : mfSample(fSample), mBase_ms(baseTime_ms) {}
+
+    // Targets in time order, the last feed can be empty. Appends placed targets and walls.
+    void feed(const EntityT* pFirst, const EntityT* pLast, bool isLast, vector<EntityT>& rOutNotes, vector<EntityT>& rOutWalls)
+    {
+        if (!mAhead.empty())
+        {
+            mAhead.insert(mAhead.end(), pFirst, pLast);
+            pFirst = mAhead.data();
+            pLast = pFirst + mAhead.size();
         }
-        evList.push_front(evn);
+        // a sweep reads up to four timelines ahead
+        const EntityT* pStop = isLast ? pLast : findLastTimelines(pFirst, pLast, 4);
+        for (auto pSrc=pFirst; pSrc!=pStop; ++pSrc)
+        {
+            place(pSrc, pLast, rOutNotes, rOutWalls);
+        }
+        if (isLast)
+            assignLine(rOutNotes);
 
+        if (mAhead.empty())
+            mAhead.assign(pStop, pLast);
+        else
+            mAhead.erase(mAhead.begin(), mAhead.begin() + (pStop - pFirst));
     }
 
-    // Turn on environment light (blue) on first target
-    if (src!=tarEnd)
+private:
+    void place(const EntityT* pSrc, const EntityT* pLast, vector<EntityT>& rOutNotes, vector<EntityT>& rOutWalls)
     {
-        evn.Timestamp = quantizeTimestamp(src->SpawnTime, baseTime_ms, rInOut.Setting.SubgridSize);
-        evn.Value = (float)Switch_t::s1_on;
-        evn.EventType = EventType_t::sw_lightSd;
-        evList.push_front(evn);
-    }
-    */
-    auto dst = rInOut.Targets.begin();
-    auto tarEnd = rInOut.Targets.cend();
-    auto src = find_if(rInOut.Targets.cbegin(), tarEnd, [ ](EntityT en) {
-            return en.SpawnTime > LEAD_IN_TIME_MS;
-        });
-
-    // Transform targets in-place
-    // DO NOT ADD MORE TARGETS THAN CONTAINER SIZE
-    EntityT obj;
-    EntityT obs;
-    bool isLeft = true;
-    //bool fixedRow = GameMode_t::os_mania == rInOut.Setting.Mode;
-    float timeSlots[4][3] = {};  // 4:x, 3:y
-    float lastSample{};
-    //size_t equalCnt{};
-
-    //for (auto&& rows : timeSlots)
-    //{// Init each slot to 2sec.
-    //    fill(rows, &rows[3], 2000.f);
-    //}
-
-    rInOut.Objects.clear();
-    float tSample{};
-    for (; src!=tarEnd; ++src)
-    {// src and dst CAN be same -> obj used as work copy
-        obj.Location.first = (uint16_t)(src->Location.first / OS_COL_SZ);
+        const auto& src = *pSrc;
+        if (!(src.Type.OsuType.IsCircle || src.Type.OsuType.IsContinous))
+            return;
+
+        EntityT obj;
+        EntityT obs;
+        obj.Location.first = (uint16_t)(src.Location.first / OS_COL_SZ);
         obj.Location.second = 0;
         obj.Value = enum_cast(Direction_t::fwd);  // TODO give some direction logic
-        obj.SpawnTime = ftRelative(src->SpawnTime); //quantizeTimestamp(src->SpawnTime, baseTime_ms, rInOut.Setting.SubgridSize);
-        //obj.Type.RawType == 0
+        const auto tick = mfSample.toTicks(src.SpawnTime);
+        obj.SpawnTime = mfSample.toBeats(tick);
         assert(obj.Location.first < Bs_Map_Width);
         assert(obj.Location.second < Bs_Map_Height);
 
-        if (src->Type.OsuType.IsComboStart)
-        {
-            evList.emplace_front(
-                EventT{
-                    EventType_t::sw_lightSd,
-                    obj.SpawnTime,
-                    (float)enum_cast(isLeft ? Switch_t::s2_on : Switch_t::s1_on)
-                });
-            isLeft = !isLeft; // toggle color
-        }
-
-        if (src->Type.OsuType.IsCircle || 
-            src->Type.OsuType.IsContinous)
+        // Add top row wall with target on front
+        if (src.Type.OsuType.IsContinous)
         {
-            // Add top row wall with target on front
-            if (src->Type.OsuType.IsContinous){
-                obs.Location.first = obj.Location.first;
-                obs.Location.second = 1;  // used as wall width
-                obs.SpawnTime = obj.SpawnTime;
-                obs.Type.RawType = WALL_HORIZONTAL;
-                obs.Value = ftRelative(src->Value - src->SpawnTime); //quantizeTimestamp(src->Value - src->SpawnTime, baseTime_ms, rInOut.Setting.SubgridSize);  // used as duration
-                if (1.f <= obs.Value)
+            obs.Location.first = obj.Location.first;
+            obs.Location.second = 1;  // used as wall width
+            obs.SpawnTime = obj.SpawnTime;
+            obs.Type.RawType = WALL_HORIZONTAL;
+            obs.Value = mfSample(src.Value) - obs.SpawnTime;  // used as duration, segments may differ in rate
+            if (1.f <= obs.Value)
+            {
+                mTimeSlots[obs.Location.first][2] = mTimeSlots[obs.Location.first][1] = src.Value;  // (value:end timestamp) wall blocks upper rows for the duration
+                rOutWalls.push_back(obs);
+            }
+        } else if (0 == obj.Location.first || 3 == obj.Location.first) {// Detect temporal sweeps
+            auto pEnd = isSweepPattern(pSrc, pLast, mBase_ms);
+            if (pLast != pEnd)
+            {
+                // wall blocks side columns for the duration
+                if (obj.Location.first)
                 {
-                    timeSlots[obs.Location.first][2] = timeSlots[obs.Location.first][1] = src->Value;  // (value:end timestamp) wall blocks upper rows for the duration
-                    rInOut.Objects.push_back(obs);
+                    obs.Location.first = 2;
+                    mTimeSlots[1][2] = mTimeSlots[2][2] = mTimeSlots[3][2] =
+                        mTimeSlots[1][1] = mTimeSlots[2][1] = mTimeSlots[3][1] =
+                        mTimeSlots[1][0] = mTimeSlots[2][0] = mTimeSlots[3][0] =
+                        pEnd->SpawnTime + BLOCK_PLACEMENT_DOWNTIME_MS;
+                } else {
+                    obs.Location.first = 0;
+                    mTimeSlots[0][2] = mTimeSlots[1][2] = mTimeSlots[2][2] =
+                        mTimeSlots[0][1] = mTimeSlots[1][1] = mTimeSlots[2][1] =
+                        mTimeSlots[0][0] = mTimeSlots[1][0] = mTimeSlots[2][0] =
+                        pEnd->SpawnTime + BLOCK_PLACEMENT_DOWNTIME_MS;
                 }
-            } else if (0 == obj.Location.first || 3 == obj.Location.first) {// Detect temporal sweeps
-                auto tmpIt = isSweepPattern(src, tarEnd, baseTime_ms);
-                if (tarEnd != tmpIt)
-                {
-                    // wall blocks side columns for the duration
-                    if (obj.Location.first)
-                    {
-                        obs.Location.first = 2;
-                        timeSlots[1][2] = timeSlots[2][2] = timeSlots[3][2] =
-                            timeSlots[1][1] = timeSlots[2][1] = timeSlots[3][1] =
-                            timeSlots[1][0] = timeSlots[2][0] = timeSlots[3][0] =
-                            tmpIt->SpawnTime + BLOCK_PLACEMENT_DOWNTIME_MS;
-                    } else {
-                        obs.Location.first = 0;
-                        timeSlots[0][2] = timeSlots[1][2] = timeSlots[2][2] =
-                            timeSlots[0][1] = timeSlots[1][1] = timeSlots[2][1] =
-                            timeSlots[0][0] = timeSlots[1][0] = timeSlots[2][0] =
-                            tmpIt->SpawnTime + BLOCK_PLACEMENT_DOWNTIME_MS;
-                    }
-                    obs.Type.RawType = WALL_VERTICAL;
-                    obs.Location.second = 2;  // used as wall width
-                    obs.SpawnTime = obj.SpawnTime;
-                    obs.Value = ftRelative(tmpIt->SpawnTime - src->SpawnTime); //quantizeTimestamp(tmpIt->SpawnTime - src->SpawnTime, baseTime_ms, rInOut.Setting.SubgridSize);
-
-                    if (obs.SpawnTime > tSample)
-                    {// Avoid stacking or unevadable walls
-                        rInOut.Objects.push_back(obs);
-                        tSample = obs.SpawnTime + obs.Value + 1.f;
-                    }
-                    continue;
+                obs.Type.RawType = WALL_VERTICAL;
+                obs.Location.second = 2;  // used as wall width
+                obs.SpawnTime = obj.SpawnTime;
+                obs.Value = mfSample(pEnd->SpawnTime) - obs.SpawnTime;
+
+                if (obs.SpawnTime > mtWall)
+                {// Avoid stacking or unevadable walls
+                    rOutWalls.push_back(obs);
+                    mtWall = obs.SpawnTime + obs.Value + 1.f;
                 }
+                return;
             }
+        }
 
-            // Minimum spacing of neighbour targets
-            if (lastSample != obj.SpawnTime)  
-            {// A new timeline (quantized timestamp!)
-                if (BLOCK_PLACEMENT_DOWNTIME_NEIGHBOUR_MS > baseTime_ms * (obj.SpawnTime - lastSample))
-                    continue;
-                lastSample = obj.SpawnTime;
-            }
-             // Minimum spacing (200ms is fastest beat, 55.6ms is world record in keyboard typing)
-             // Blocks are touching each other under about 120ms
-            if (BLOCK_PLACEMENT_DOWNTIME_MS < (src->SpawnTime - timeSlots[obj.Location.first][obj.Location.second]))  // negative considered as blocked
-            {// Also avoids targets within upper walls
-                timeSlots[obj.Location.first][obj.Location.second] = src->SpawnTime;
-                swap(obj, *dst);  // do not use values of obj or src after this line!
-                ++dst;
-            }
+        // Minimum spacing of neighbour targets
+        if (mLastTick != tick)
+        {// A new timeline
+            if (BLOCK_PLACEMENT_DOWNTIME_NEIGHBOUR_MS > mBase_ms * (obj.SpawnTime - mfSample.toBeats(mLastTick)))
+                return;
+            mLastTick = tick;
+        }
+         // Minimum spacing (200ms is fastest beat, 55.6ms is world record in keyboard typing)
+         // Blocks are touching each other under about 120ms
+        if (BLOCK_PLACEMENT_DOWNTIME_MS < (src.SpawnTime - mTimeSlots[obj.Location.first][obj.Location.second]))  // negative considered as blocked
+        {// Also avoids targets within upper walls
+            mTimeSlots[obj.Location.first][obj.Location.second] = src.SpawnTime;
+            if (!mLine.empty() && (mLineTick != tick))
+                assignLine(rOutNotes);
+            mLineTick = tick;
+            mLine.push_back(obj);
         }
     }
-    if (dst != rInOut.Targets.end())
-    {
-        rInOut.Targets.erase(dst, rInOut.Targets.end());
-    }
-    /*
-    // Sort added events by timestamp ascendingly and move into argument container
-    evList.sort([ ](EventT evn, EventT other) {
-        return evn.Timestamp < other.Timestamp;
-    });
-    rInOut.Events.resize(distance(evList.cbegin(), evList.cend()));  // list has no size()
-    assert(rInOut.Events.size() > 0);
-    move(evList.begin(), evList.end(), rInOut.Events.begin());
 
-    // Set Bs specific meta
-    rInOut.Game = NaiSe::GameTypes_t::beatsaber;
-    rInOut.Setting.Mode = NaiSe::GameMode_t::bs_2H_free;  // TODO add other modes
-    rInOut.Setting.MapName = MODE_NAME_NA;
-    rInOut.Setting.MapName.append(STAGE_NAMES[rInOut.StageLevel>>1]);
-    */
-    if (rInOut.Targets.empty())
-        return;
-
-    // Assign left/right targets
-    ptrdiff_t tarCnt;
-    auto lneEnd = rInOut.Targets.end();
-
-    tarEnd = rInOut.Targets.cend();
-    isLeft = true;
-    src = rInOut.Targets.cbegin();
-    dst = rInOut.Targets.begin();
-    while (src != tarEnd)
+    // Assigns left/right targets of the line by its number of targets and hands it out
+    void assignLine(vector<EntityT>& rOutNotes)
     {
-        lneEnd = upper_bound(dst, rInOut.Targets.end(), *dst, [ ](const EntityT& en, const EntityT& nxt) {
-            return en.SpawnTime < nxt.SpawnTime;
-        });
-        tarCnt = distance(dst, lneEnd);
-
-        switch (tarCnt)  // number of inline targets
+        size_t adjacent{};
+        switch (mLine.size())  // number of inline targets
         {
         case 0:
             break;
@@ -578,57 +703,48 @@ void transform_mania(
             // regular assign
         case 1:
         case 2:
-            while (src != lneEnd)
+            for (auto&& tar : mLine)
             {
-                dst->Type.RawType = enum_cast((src->Location.first < 2) ?
+                tar.Type.RawType = enum_cast((tar.Location.first < 2) ?
                     Cube_t::left : Cube_t::right);
-                ++dst; src++;
             }
             break;
 
             // twist assign
         case 3:
             // count adjacent targets
-            sort(dst, lneEnd,
+            sort(mLine.begin(), mLine.end(),
                 [](const EntityT& en, const EntityT& other) {
                     return en.Location.first < other.Location.first;
                 });
-            tarCnt = 0;
-            while (src != lneEnd)  
-            {
-                if (tarCnt == src->Location.first)
-                    ++tarCnt;
-                else
-                    break;
-                ++src;
-            }
-            switch (tarCnt)  // number of left adjacent (connected) targets
+            while ((adjacent < mLine.size()) && (adjacent == mLine[adjacent].Location.first))
+                ++adjacent;
+
+            switch (adjacent)  // number of left adjacent (connected) targets
             {
             case 0:  // right side
-                while (dst != lneEnd)
+                for (auto&& tar : mLine)
                 {
-                    dst->Type.RawType = (uint8_t)Cube_t::left;
-                    ++dst;
+                    tar.Type.RawType << Cube_t::left;
                 }
                 break;
 
             case 1:
-                (dst++)->Type.RawType << Cube_t::left;
-                (dst++)->Type.RawType << Cube_t::bomb;
-                (dst++)->Type.RawType << Cube_t::bomb;
+                mLine[0].Type.RawType << Cube_t::left;
+                mLine[1].Type.RawType << Cube_t::bomb;
+                mLine[2].Type.RawType << Cube_t::bomb;
                 break;
 
             case 2:
-                (dst++)->Type.RawType << Cube_t::bomb;
-                (dst++)->Type.RawType << Cube_t::bomb;
-                (dst++)->Type.RawType << Cube_t::right;
+                mLine[0].Type.RawType << Cube_t::bomb;
+                mLine[1].Type.RawType << Cube_t::bomb;
+                mLine[2].Type.RawType << Cube_t::right;
                 break;
 
             case 3:  // left side
-                while (dst != lneEnd)
+                for (auto&& tar : mLine)
                 {
-                    dst->Type.RawType << Cube_t::right;
-                    ++dst;
+                    tar.Type.RawType << Cube_t::right;
                 }
                 break;
             }
@@ -636,352 +752,315 @@ void transform_mania(
 
             // alternating assign
         case 4:
-            while (dst != lneEnd)
+            for (auto&& tar : mLine)
             {
-                dst->Type.RawType << (isLeft ? Cube_t::left : Cube_t::right);
-                ++dst;
+                tar.Type.RawType << (mIsLeft ? Cube_t::left : Cube_t::right);
             }
-            isLeft = !isLeft;
+            mIsLeft = !mIsLeft;
             break;
 
         default:
             // has targets in upper rows
-            break;
+            break;  // keep unassigned
         }
-        // keep dst, lneEnd and tarEnd iterators synced
-        src = lneEnd;
+        rOutNotes.insert(rOutNotes.end(), mLine.cbegin(), mLine.cend());
+        mLine.clear();
     }
-}
+};
 
 
-void transform_taiko(
-    vector<EntityT>&       rInOutTar,
-    const size_t           fstIdx,
-    const double           baseTime_ms,
-    forward_list<EventT>&  rOutEvents,
-    vector<EntityT>&       rOutObj,
-    function<float(float)> ftRelative,
-    GameMode_t             mode=GameMode_t::bs_2H_free)
+/// Places taiko targets for two hands, with walls along sliders. Fed in time order, the last target fed is
+/// held back until the next one tells the time left to it.
+template<typename TSampler>
+class TaikoTransform
 {
     using HitArea_t = HitTypeT::area_t;
-    assert(ftRelative);
-    if (rInOutTar.empty())
-        return;
-    
-    // TODO validate game mode when implemented
 
-    bool isBlue = true;
-    bool isLeft{};
-    float timeSlots[2] = {};
-    float nextTs{};
-    const auto tarSz = rInOutTar.size();
-
-    vector<EntityT> tars;
-    EntityT out;
-    HitTypeT ht;
+    const TSampler& mfSample;
+    const double mBase_ms;
+    const GameMode_t mMode;
+    EntityColumnsT mTars{xmemory::CScratchScope::scratch()};  // placed during one feed
+    EntityT mHeld;
+    EntityT mOut;
+    HitTypeT mHt;
+    float mTimeSlots[2] = {};  // last target of each hand
+    float mSwingSlots[2] = {};  // last down swing of each hand
+    float mNext_ms{};
+    bool mHasHeld{};
+    bool mIsLeft{};
+
+public:
+    TaikoTransform(const TSampler& fSample, double baseTime_ms, GameMode_t mode=GameMode_t::bs_2H_free) :
+        mfSample(fSample),
+        mBase_ms(baseTime_ms),
+        mMode(mode)
+    {
+        // TODO validate game mode when implemented
+        mOut.Value = enum_cast(Direction_t::fwd);
+    }
 
-    out.Value = enum_cast(Direction_t::fwd);
-    for (auto i=fstIdx+1; i<=tarSz; ++i)
+    // Targets in time order, the last feed can be empty. Appends placed targets and walls.
+    void feed(const EntityT* pFirst, const EntityT* pLast, bool isLast, vector<EntityT>& rOutNotes, vector<EntityT>& rOutWalls)
     {
-        const auto& tar = rInOutTar[i - 1];
-        if (tar.Type.OsuType.IsComboStart)
-        {// toggle color
-            rOutEvents.emplace_front(
-                EventT{
-                    EventType_t::sw_lightSd,
-                    ftRelative(tar.SpawnTime),
-                    (float)enum_cast(isBlue ? Switch_t::s2_on : Switch_t::s1_on)
-                });
-            isBlue = !isBlue; 
+        for (; pFirst!=pLast; ++pFirst)
+        {
+            if (mHasHeld)
+                place(mHeld, pFirst->SpawnTime, rOutWalls);
+            mHeld = *pFirst;
+            mHasHeld = true;
+        }
+        if (isLast && mHasHeld)
+        {
+            place(mHeld, mNext_ms + LEAD_IN_TIME_MS, rOutWalls);
+            mHasHeld = false;
         }
 
-        //--> Next target (if any)
-        if (i < tarSz)
-            nextTs = rInOutTar[i].SpawnTime;
-        else
-            nextTs += LEAD_IN_TIME_MS;
-        //<--
+        if (mMode == GameMode_t::bs_2H)
+            assignDirections();
+        mTars.appendTo(rOutNotes);
+        mTars.clear();
+    }
 
+private:
+    void place(const EntityT& tar, float nextTs, vector<EntityT>& rOutWalls)
+    {
+        mNext_ms = nextTs;
         if (tar.Type.OsuType.IsCircle)
         {// Single action
 
             // Minimum spacing of same hand targets
-            if (BLOCK_PLACEMENT_DOWNTIME_MS > (tar.SpawnTime - timeSlots[isLeft ? 0 : 1]))
-                continue;
-
-            timeSlots[isLeft ? 0 : 1] = tar.SpawnTime;
-            out.SpawnTime = ftRelative(tar.SpawnTime);
-            bool isFinisher = (2 * baseTime_ms) < (nextTs - tar.SpawnTime);
-            ht.setF(tar.Value);
-            switch (ht.Area)
+            if (BLOCK_PLACEMENT_DOWNTIME_MS > (tar.SpawnTime - mTimeSlots[mIsLeft ? 0 : 1]))
+                return;
+
+            mTimeSlots[mIsLeft ? 0 : 1] = tar.SpawnTime;
+            mOut.SpawnTime = mfSample(tar.SpawnTime);
+            bool isFinisher = (2 * mBase_ms) < (nextTs - tar.SpawnTime);
+            mHt.setF(tar.Value);
+            switch (mHt.Area)
             {
             case HitArea_t::don:
             case HitArea_t::softCenter:
             default:
-                out.Location.first = isLeft ? 1 : 2;
-                out.Location.second = isFinisher ? 1 : 0;
-                out.Type.RawType << (isLeft ? Cube_t::left : Cube_t::right);
-                tars.emplace_back(out);
-                isLeft = !isLeft;
+                mOut.Location.first = mIsLeft ? 1 : 2;
+                mOut.Location.second = isFinisher ? 1 : 0;
+                mOut.Type.RawType << (mIsLeft ? Cube_t::left : Cube_t::right);
+                mTars.push_back(mOut);
+                mIsLeft = !mIsLeft;
                 break;
 
             case HitArea_t::katsu:
             case HitArea_t::rim:
-                if (isLeft)
+                if (mIsLeft)
                 {
-                    out.Type.RawType << Cube_t::left;
+                    mOut.Type.RawType << Cube_t::left;
                     if (isFinisher)
                     {
-                        out.Location.first = 1;
-                        out.Location.second = 2;
+                        mOut.Location.first = 1;
+                        mOut.Location.second = 2;
                     } else {
-                        out.Location.first = 0;
-                        out.Location.second = 0;
+                        mOut.Location.first = 0;
+                        mOut.Location.second = 0;
                     }
                 } else {
-                    out.Type.RawType << Cube_t::right;
+                    mOut.Type.RawType << Cube_t::right;
                     if (isFinisher)
                     {
-                        out.Location.first = 2;
-                        out.Location.second = 2;
+                        mOut.Location.first = 2;
+                        mOut.Location.second = 2;
                     } else {
-                        out.Location.first = 3;
-                        out.Location.second = 0;
+                        mOut.Location.first = 3;
+                        mOut.Location.second = 0;
                     }
                 }
-                tars.emplace_back(out);
-                isLeft = !isLeft;
+                mTars.push_back(mOut);
+                mIsLeft = !mIsLeft;
                 break;
 
             case HitArea_t::dondon:
             case HitArea_t::hardCenter:
-                out.Location.first = 1;
-                out.Location.second = isFinisher ? 1 : 0;
-                out.Type.RawType << Cube_t::left;
-                tars.emplace_back(out);
-                out.Location.first = 2;
-                out.Type.RawType << Cube_t::right;
-                tars.emplace_back(out);
+                mOut.Location.first = 1;
+                mOut.Location.second = isFinisher ? 1 : 0;
+                mOut.Type.RawType << Cube_t::left;
+                mTars.push_back(mOut);
+                mOut.Location.first = 2;
+                mOut.Type.RawType << Cube_t::right;
+                mTars.push_back(mOut);
                 break;
 
             case HitArea_t::katatsu:
             case HitArea_t::sides:
                 if (isFinisher)
                 {
-                    out.Location.first = 1;
-                    out.Location.second = 2;
+                    mOut.Location.first = 1;
+                    mOut.Location.second = 2;
                 }else {
-                    out.Location.first = 0;
-                    out.Location.second = 1;
+                    mOut.Location.first = 0;
+                    mOut.Location.second = 1;
                 }
-                out.Type.RawType << Cube_t::left;
-                tars.emplace_back(out);
-                out.Location.first = isFinisher ? 2 : 3;
-                out.Type.RawType << Cube_t::right;
-                tars.emplace_back(out);
+                mOut.Type.RawType << Cube_t::left;
+                mTars.push_back(mOut);
+                mOut.Location.first = isFinisher ? 2 : 3;
+                mOut.Type.RawType << Cube_t::right;
+                mTars.push_back(mOut);
                 break;
             }
         } else if(tar.Type.OsuType.IsSlider) {  // duration limited multi action
-            auto tMax = min((float)baseTime_ms / 140.f * tar.Value + tar.SpawnTime, nextTs-BLOCK_PLACEMENT_DOWNTIME_MS);
-            out.Location.first = isLeft ? 2 : 0;
-            out.Location.second = 2;
-            out.Type.RawType = WALL_VERTICAL;
-            out.SpawnTime = ftRelative(tar.SpawnTime);
-            out.Value = ftRelative(tMax - tar.SpawnTime);
-            rOutObj.emplace_back(out);
-            out.Location.second = 0;
-            out.Value = enum_cast(Direction_t::fwd);
-            bool isSideL = isLeft;
+            auto tMax = min((float)mBase_ms / 140.f * tar.Value + tar.SpawnTime, nextTs-BLOCK_PLACEMENT_DOWNTIME_MS);
+            mOut.Location.first = mIsLeft ? 2 : 0;
+            mOut.Location.second = 2;
+            mOut.Type.RawType = WALL_VERTICAL;
+            mOut.SpawnTime = mfSample(tar.SpawnTime);
+            mOut.Value = mfSample(tMax) - mOut.SpawnTime;
+            rOutWalls.emplace_back(mOut);
+            mOut.Location.second = 0;
+            mOut.Value = enum_cast(Direction_t::fwd);
+            bool isSideL = mIsLeft;
             for (auto ts=tar.SpawnTime; ts<tMax; ts+=250.f)
             {
                 if (isSideL)
-                    out.Location.first = 0;
+                    mOut.Location.first = 0;
                 else
-                    out.Location.first = 3;
-                out.Type.RawType << (isLeft ? Cube_t::left : Cube_t::right);
-                out.SpawnTime = ftRelative(ts);
-                tars.emplace_back(out);
-                isLeft = !isLeft;
+                    mOut.Location.first = 3;
+                mOut.Type.RawType << (mIsLeft ? Cube_t::left : Cube_t::right);
+                mOut.SpawnTime = mfSample(ts);
+                mTars.push_back(mOut);
+                mIsLeft = !mIsLeft;
             }
         }else if(tar.Type.OsuType.IsSpin) {  // end limited multi action
             auto tMax = min(tar.Value, nextTs - BLOCK_PLACEMENT_DOWNTIME_MS);
-            for (auto ts = tar.SpawnTime; ts < tMax; ts += (float)baseTime_ms)
+            for (auto ts = tar.SpawnTime; ts < tMax; ts += (float)mBase_ms)
             {
-                out.SpawnTime = ftRelative(ts);
+                mOut.SpawnTime = mfSample(ts);
 
                 //--> bomb sequence
-                out.Type.RawType << Cube_t::bomb;
-                out.Location.first = 0;
-                out.Location.second = 1;
-                tars.emplace_back(out);
+                mOut.Type.RawType << Cube_t::bomb;
+                mOut.Location.first = 0;
+                mOut.Location.second = 1;
+                mTars.push_back(mOut);
 
-                out.Location.first = 3;
-                tars.emplace_back(out);
+                mOut.Location.first = 3;
+                mTars.push_back(mOut);
 
-                out.Location.first = 0;
-                if (isLeft)
+                mOut.Location.first = 0;
+                if (mIsLeft)
                 {
-                    out.Location.second = 0;
-                    tars.emplace_back(out);
+                    mOut.Location.second = 0;
+                    mTars.push_back(mOut);
 
-                    out.Location.first = 3;
-                    out.Location.second = 2;
+                    mOut.Location.first = 3;
+                    mOut.Location.second = 2;
                 } else {
-                    out.Location.second = 2;
-                    tars.emplace_back(out);
+                    mOut.Location.second = 2;
+                    mTars.push_back(mOut);
 
-                    out.Location.first = 3;
-                    out.Location.second = 0;
+                    mOut.Location.first = 3;
+                    mOut.Location.second = 0;
                 }
-                tars.emplace_back(out);
+                mTars.push_back(mOut);
                 //<-- bombs
 
-                out.Location.first = 2;
-                out.Type.RawType << Cube_t::right;
-                tars.emplace_back(out);
+                mOut.Location.first = 2;
+                mOut.Type.RawType << Cube_t::right;
+                mTars.push_back(mOut);
 
-                out.Location.first = 1;
-                out.Location.second = isLeft ? 0 : 2;
-                out.Type.RawType << Cube_t::left;
-                tars.emplace_back(out);
+                mOut.Location.first = 1;
+                mOut.Location.second = mIsLeft ? 0 : 2;
+                mOut.Type.RawType << Cube_t::left;
+                mTars.push_back(mOut);
 
-                isLeft = !isLeft;
+                mIsLeft = !mIsLeft;
             }
-            timeSlots[0] = timeSlots[1] = tar.Value;
+            mTimeSlots[0] = mTimeSlots[1] = tar.Value;
         }// types of targets
-    }//each target
+    }
 
-    if (mode == GameMode_t::bs_2H)
-    {// 2nd pass (may contain equal time sequences)
-        // Position based direction assignment
-        timeSlots[0] = timeSlots[1] = 0;  //last down swing time
-        for (auto&& tn : tars)
-        {
-            if (tn.Type.RawType == enum_cast(Cube_t::bomb))
+    // 2nd pass (may contain equal time sequences)
+    // Position based direction assignment
+    void assignDirections()
+    {
+        auto& tars = mTars;
+        for (size_t j=0; j<tars.size(); ++j)
+        {// reads type, lane, layer and time columns, writes value column
+            if (tars.Type[j] == enum_cast(Cube_t::bomb))
                 continue;
-            isLeft = tn.Type.RawType == enum_cast(Cube_t::left);
-            switch (tn.Location.second)
+            const bool isLeft = tars.Type[j] == enum_cast(Cube_t::left);
+            switch (tars.Layer[j])
             {
             case 0:
-                switch (tn.Location.first)
+                switch (tars.Lane[j])
                 {
                 case 0:
                 case 3:  // these slots can have opposite side hand
                     if (isLeft)
                     {
-                        tn.Value = (float)enum_cast(Direction_t::rDown);
-                        timeSlots[0] = tn.SpawnTime;
+                        tars.Value[j] = (float)enum_cast(Direction_t::rDown);
+                        mSwingSlots[0] = tars.SpawnTime[j];
                     } else {
-                        tn.Value = (float)enum_cast(Direction_t::lDown);
-                        timeSlots[1] = tn.SpawnTime;
+                        tars.Value[j] = (float)enum_cast(Direction_t::lDown);
+                        mSwingSlots[1] = tars.SpawnTime[j];
                     }
                     break;
 
                 case 1:
                 case 2:
-                    if (.75f < (tn.SpawnTime - timeSlots[isLeft ? 0 : 1]))
+                    if (.75f < (tars.SpawnTime[j] - mSwingSlots[isLeft ? 0 : 1]))
                     {
-                        tn.Value = (float)enum_cast(Direction_t::down);
-                        timeSlots[isLeft ? 0 : 1] = tn.SpawnTime;
+                        tars.Value[j] = (float)enum_cast(Direction_t::down);
+                        mSwingSlots[isLeft ? 0 : 1] = tars.SpawnTime[j];
                     } else {
-                        tn.Value = (float)enum_cast(Direction_t::up);
+                        tars.Value[j] = (float)enum_cast(Direction_t::up);
                     }
                     break;
                 }
                 break;
 
             case 1:
-                switch (tn.Location.first)
+                switch (tars.Lane[j])
                 {
                 case 0:
-                    tn.Value = (float)enum_cast(Direction_t::lUp);
-                    timeSlots[0] = tn.SpawnTime;
+                    tars.Value[j] = (float)enum_cast(Direction_t::lUp);
+                    mSwingSlots[0] = tars.SpawnTime[j];
                     break;
 
                 case 1:
-                    timeSlots[0] = tn.SpawnTime;
+                    mSwingSlots[0] = tars.SpawnTime[j];
                 case 2:
-                    timeSlots[1] = tn.SpawnTime;
-                    tn.Value = (float)enum_cast(Direction_t::fwd);
+                    mSwingSlots[1] = tars.SpawnTime[j];
+                    tars.Value[j] = (float)enum_cast(Direction_t::fwd);
                     break;
 
                 case 3:
-                    tn.Value = (float)enum_cast(Direction_t::rUp);
-                    timeSlots[1] = tn.SpawnTime;
+                    tars.Value[j] = (float)enum_cast(Direction_t::rUp);
+                    mSwingSlots[1] = tars.SpawnTime[j];
                     break;
                 }
                 break;
 
             case 2:
-                timeSlots[isLeft ? 0 : 1] = tn.SpawnTime;
-                tn.Value = (float)enum_cast(Direction_t::up);
+                mSwingSlots[isLeft ? 0 : 1] = tars.SpawnTime[j];
+                tars.Value[j] = (float)enum_cast(Direction_t::up);
                 break;
             }
             
         }
     }
-    rInOutTar = tars;
-}
-
-
-void CBsSequencer::transformBeatset(BeatSetT& rInOut)
-{
-    if (GameTypes_t::beatsaber == rInOut.Game)
-        return;
-
-    assert(GameTypes_t::osu == rInOut.Game);
+};
 
-    const double baseTime_ms = 60000.f / max(1.f, min(rInOut.Media.AverageRate_bpm, (float)BS_MAX_BPM));
-
-    size_t i_fst{};
-    float tFirst;
-    auto tarEnd = rInOut.Targets.cend();
-    auto fSample =
-        [P=baseTime_ms, S=rInOut.Setting.SubgridSize](float t) {
-        return quantizeTimestamp(t, P, S);
-    };
-    forward_list<EventT> evList;
+}// anonymous ns
 
-    // Find index of first target after lead-in and create light events accordingly
-    while (i_fst < rInOut.Targets.size())
-    {
-        if (LEAD_IN_TIME_MS < (tFirst = rInOut.Targets[i_fst].SpawnTime))
-            break;
-        ++i_fst;
-    }
-    processEvents(rInOut.Events, evList, rInOut.Setting.LeadIn_ms, (uint16_t)min<float>(tFirst, UINT16_MAX), fSample);
-    if (!rInOut.Targets[i_fst].Type.OsuType.IsComboStart)
-    {
-        evList.emplace_front(
-            EventT{
-                EventType_t::sw_lightSd,
-                quantizeTimestamp(tFirst, baseTime_ms, rInOut.Setting.SubgridSize),
-                (float)enum_cast(Switch_t::s1_on)
-            });
-    }
 
-    //assert(
-    //    mEnabledModes == BsModeFlagsT::FREESTYLE ||
-    //    mEnabledModes == BsModeFlagsT::SUPPORTED);
+void CBsSequencer::assignMode(BeatSetT& rInOut)
+{
     switch (rInOut.Setting.Mode)
     {
     case GameMode_t::os_mania:
-        transform_mania(rInOut, baseTime_ms, evList, fSample);  //TODO test after refactor
         rInOut.Setting.Mode = GameMode_t::bs_2H_free;  // TODO add other modes
         rInOut.Setting.MapName = MODE_NAME_NA;
         break;
 
     case GameMode_t::os_taiko:
-        transform_taiko(
-            rInOut.Targets,
-            i_fst,
-            baseTime_ms,
-            evList,
-            rInOut.Objects,
-            fSample,
-            GameMode_t::bs_2H);  // supported: free and 2H
         mEnabledModes |= BsModeFlagsT::TWO_HAND;
-        rInOut.Setting.Mode = GameMode_t::bs_2H;
+        rInOut.Setting.Mode = GameMode_t::bs_2H;  // supported: free and 2H
         rInOut.Setting.MapName = MODE_NAME_NM;
         break;
 
@@ -989,90 +1068,276 @@ void CBsSequencer::transformBeatset(BeatSetT& rInOut)
         throw logic_error("CBsSequencer::transformBeatset - Game mode unsupported");
     }
 
-    // Sort added events by timestamp ascendingly and move into argument container
-    auto evIt = rInOut.Events.begin();
-    size_t sz = rInOut.Events.size();
-    evList.sort(
-        [ ](EventT evn, EventT other) {
-        return evn.Timestamp < other.Timestamp;
-    });
-    while (!evList.empty())
-    {
-        if (sz)
-        {
-            *evIt = move(evList.front());
-            ++evIt; --sz;
-        } else {
-            rInOut.Events.emplace_back(move(evList.front()));
-        }
-        evList.pop_front();
-    }
-
     // Set Bs specific meta
     rInOut.Game = NaiSe::GameTypes_t::beatsaber;
     rInOut.Setting.MapName.append(rInOut.StageLevel ? STAGE_NAMES[rInOut.StageLevel >> 1] : "_Map");
 }
 
 
-vector<string> CBsSequencer::serializeBeatset(const NaiSe::BeatSetT& rIn) const
+void CBsSequencer::transformBeatset(BeatSetT& rInOut)
 {
-    stringstream strbuff;
-    vector<string> container;
-
-    //strbuff.precision(rIn.Setting.SubgridSize); could limit precision on large numbers
-    //strbuff.setf(ios::fixed, ios::floatfield); always appends zeroes
+    if (GameTypes_t::beatsaber == rInOut.Game)
+    {// sequenced already, only its mode goes to the index and a stage renames it
+        const char* modeName;
+        switch (rInOut.Setting.Mode)
+        {
+        case GameMode_t::bs_1H:
+            mEnabledModes |= BsModeFlagsT::ONE_HAND;
+            modeName = MODE_NAME_OS;
+            break;
 
-    // Header
-    strbuff << "{\"_version\":" << '"' << getVersion() << "\",";
+        case GameMode_t::bs_2H:
+            mEnabledModes |= BsModeFlagsT::TWO_HAND;
+            modeName = MODE_NAME_NM;
+            break;
 
-    strbuff << "\"_events\":[";
-    if (!rIn.Events.empty())
-    {
-        auto evIt = rIn.Events.cbegin();
-        ss_appendEvent(strbuff, *evIt);
-        ++evIt;
-        for (auto end=rIn.Events.cend(); evIt!=end; ++evIt)
-        {
-            strbuff << ',';
-            ss_appendEvent(strbuff, *evIt);
+        default:
+            mEnabledModes |= BsModeFlagsT::FREESTYLE;
+            modeName = MODE_NAME_NA;
+            break;
+        }
+        if (rInOut.StageLevel)
+        {// the index refers to the stage it is stored as, loose maps keep their name
+            rInOut.Setting.MapName = modeName;
+            rInOut.Setting.MapName.append(STAGE_NAMES[rInOut.StageLevel >> 1]);
         }
+        return;
     }
-    strbuff << "],";
 
-    strbuff << "\"_notes\":[";
-    if (!rIn.Targets.empty())
-    {
-        auto evIt = rIn.Targets.cbegin();
-        ss_appendTarget(strbuff, *evIt);
-        ++evIt;
-        for (auto end=rIn.Targets.cend(); evIt!=end; ++evIt)
+    assert(GameTypes_t::osu == rInOut.Game);
+
+    const auto osuMode = rInOut.Setting.Mode;
+    assignMode(rInOut);
+
+    const double baseTime_ms = 60000.f / max(1.f, min(rInOut.Media.AverageRate_bpm, (float)BS_MAX_BPM));
+
+    const EntityT* const pBegin = rInOut.Targets.data();
+    const EntityT* const pEnd = pBegin + rInOut.Targets.size();
+    pmr::vector<EventT> evList(xmemory::CScratchScope::scratch());  // light and speed events, follow the timing points
+    pmr::vector<EventT> comboList(xmemory::CScratchScope::scratch());  // color changes, follow the targets
+    vector<EntityT> notes;
+
+    // Find first target after lead-in and create light events accordingly
+    const EntityT* const pFirst = find_if(pBegin, pEnd, isAfterLeadIn);
+    const float tFirst = (pEnd != pFirst) ? pFirst->SpawnTime : ((pBegin != pEnd) ? pEnd[-1].SpawnTime : 0.f);
+    evList.reserve(7 + 5 * rInOut.Events.size());  // up to five per timing point
+    comboList.reserve(rInOut.Targets.size() + 1);
+
+    withQuantizer(rInOut.Setting.SubgridSize, rInOut.Timing, baseTime_ms, [&](const auto& fSample) {
+        using TSampler = decay_t<decltype(fSample)>;
+        processEvents(rInOut.Events, evList, rInOut.Setting.LeadIn_ms, (uint16_t)min<float>(tFirst, UINT16_MAX), fSample);
+        ComboEvents<TSampler>(fSample).feed(pFirst, pEnd, comboList);
+
+        if (GameMode_t::os_mania == osuMode)
         {
-            strbuff << ',';
-            ss_appendTarget(strbuff, *evIt);
+            xtrace::CScope trace("transform_mania");
+            rInOut.Objects.clear();
+            notes.reserve(pEnd - pFirst);  // never more than fed
+            ManiaTransform<TSampler>(fSample, baseTime_ms).feed(pFirst, pEnd, true, notes, rInOut.Objects);
+        } else {
+            xtrace::CScope trace("transform_taiko");
+            TaikoTransform<TSampler>(fSample, baseTime_ms, GameMode_t::bs_2H).feed(pFirst, pEnd, true, notes, rInOut.Objects);
         }
-    }
-    strbuff << "],";
+    });
+    rInOut.Targets.swap(notes);
 
-    strbuff << "\"_obstacles\":[";
-    if (!rIn.Objects.empty())
-    {
-        auto evIt = rIn.Objects.cbegin();
-        ss_appendObject(strbuff, *evIt);
-        ++evIt;
-        for (auto end=rIn.Objects.cend(); evIt!=end; ++evIt)
+    // Sort both runs by timestamp ascendingly and merge them into the argument container,
+    // which is replaced. Equal timestamps keep the latest added event first.
+    sortEventRun(evList);
+    sortEventRun(comboList);
+    rInOut.Events.resize(evList.size() + comboList.size());
+    merge(comboList.cbegin(), comboList.cend(), evList.cbegin(), evList.cend(), rInOut.Events.begin(), isEventBefore);
+
+    xtrace::count("notes emitted", (int64_t)rInOut.Targets.size());
+    xtrace::count("walls emitted", (int64_t)rInOut.Objects.size());
+}
+
+
+bool CBsSequencer::streamBeatset(BeatSetT& rInOut, const ReplayFunc& fReplay, const function<bool(string_view)>& fWrite)
+{
+    assert(GameTypes_t::osu == rInOut.Game);
+    xtrace::CScope trace("streamBeatset");
+
+    const auto osuMode = rInOut.Setting.Mode;
+    assignMode(rInOut);  // named before the first piece
+
+    const double baseTime_ms = 60000.f / max(1.f, min(rInOut.Media.AverageRate_bpm, (float)BS_MAX_BPM));
+    bool isDone{};
+    string buff;
+
+    auto fSend = [&]() {
+        const bool isWritten = fWrite(buff);
+        buff.clear();
+        return isWritten;
+    };
+
+    withQuantizer(rInOut.Setting.SubgridSize, rInOut.Timing, baseTime_ms, [&](const auto& fSample) {
+        using TSampler = decay_t<decltype(fSample)>;
+
+        //--> Events, in the order transformBeatset merges them
+        pmr::vector<EventT> evList(xmemory::CScratchScope::scratch());  // light and speed events, sorted at the first target
+        pmr::vector<EventT> combos(xmemory::CScratchScope::scratch());  // of one chunk
+        pmr::vector<EventT> run(xmemory::CScratchScope::scratch());  // combo events of equal timestamp, latest first on output
+        pmr::vector<EventT> items(xmemory::CScratchScope::scratch());  // merged events of one chunk
+        ComboEvents<TSampler> combo(fSample);
+        size_t i_ev{};
+        bool isStarted{};
+        bool isFirst = true;
+        float tLast{};
+
+        auto fStart = [&](float tFirst) {
+            evList.reserve(7 + 5 * rInOut.Events.size());  // up to five per timing point
+            processEvents(rInOut.Events, evList, rInOut.Setting.LeadIn_ms, (uint16_t)min<float>(tFirst, UINT16_MAX), fSample);
+            sortEventRun(evList);
+        };
+        auto fMergeRun = [&]() {
+            for (auto it=run.crbegin(); it!=run.crend(); ++it)
+            {
+                for (; (i_ev < evList.size()) && isEventBefore(evList[i_ev], *it); ++i_ev)
+                {
+                    items.push_back(evList[i_ev]);
+                }
+                items.push_back(*it);
+            }
+            run.clear();
+        };
+
+        buff.append("{\"_version\":\"").append(getVersion()).append("\",\"_events\":[");
+        if (!fReplay([&](const vector<EntityT>& chunk) {
+            const EntityT* pFirst = chunk.data();
+            const EntityT* const pLast = pFirst + chunk.size();
+            if (pFirst == pLast)
+                return true;
+
+            tLast = pLast[-1].SpawnTime;
+            if (!isStarted)
+            {
+                if (pLast == (pFirst = find_if(pFirst, pLast, isAfterLeadIn)))
+                    return true;
+                isStarted = true;
+                fStart(pFirst->SpawnTime);
+            }
+            combo.feed(pFirst, pLast, combos);
+            for (auto&& ev : combos)
+            {
+                if (!run.empty() && isEventBefore(run.back(), ev))
+                    fMergeRun();
+                run.push_back(ev);
+            }
+            combos.clear();
+            bf_appendItems(buff, items, bf_appendEvent, BF_EVENT_MAX, isFirst);
+            items.clear();
+            return fSend();
+        }))
         {
-            strbuff << ',';
-            ss_appendObject(strbuff, *evIt);
+            return;
         }
-    }
-    strbuff << "]}";
+        if (!isStarted)
+            fStart(tLast);
+        fMergeRun();
+        items.insert(items.end(), evList.cbegin() + i_ev, evList.cend());
+        bf_appendItems(buff, items, bf_appendEvent, BF_EVENT_MAX, isFirst);
+        //<-- events
+
+        // Targets or walls of a transform, read once more
+        auto fPass = [&](auto&& transform, bool isNotes) {
+            vector<EntityT> notes;
+            vector<EntityT> walls;
+            auto& pieces = isNotes ? notes : walls;
+            auto fAppend = isNotes ? bf_appendTarget : bf_appendObject;
+            const size_t itemMax = isNotes ? BF_TARGET_MAX : BF_OBJECT_MAX;
+            bool isStarted{};
+            bool isFirst = true;
+            int64_t cnt{};
+
+            auto fPut = [&]() {
+                cnt += (int64_t)pieces.size();
+                bf_appendItems(buff, pieces, fAppend, itemMax, isFirst);
+                notes.clear();
+                walls.clear();
+            };
+            if (!fReplay([&](const vector<EntityT>& chunk) {
+                const EntityT* pFirst = chunk.data();
+                const EntityT* const pLast = pFirst + chunk.size();
+                if (!isStarted)
+                {
+                    pFirst = find_if(pFirst, pLast, isAfterLeadIn);
+                    isStarted = (pFirst != pLast);
+                }
+                transform.feed(pFirst, pLast, false, notes, walls);
+                fPut();
+                return fSend();
+            }))
+            {
+                return false;
+            }
+            transform.feed(nullptr, nullptr, true, notes, walls);
+            fPut();
+            xtrace::count(isNotes ? "notes emitted" : "walls emitted", cnt);
+            return true;
+        };
+        auto fPasses = [&](auto&& fMake) {
+            buff.append("],\"_notes\":[");
+            if (!fPass(fMake(), true))
+                return false;
+            buff.append("],\"_obstacles\":[");
+            return fPass(fMake(), false);
+        };
+
+        if (GameMode_t::os_mania == osuMode)
+        {
+            xtrace::CScope trace("transform_mania");
+            isDone = fPasses([&]() { return ManiaTransform<TSampler>(fSample, baseTime_ms); });
+        } else {
+            xtrace::CScope trace("transform_taiko");
+            isDone = fPasses([&]() { return TaikoTransform<TSampler>(fSample, baseTime_ms, GameMode_t::bs_2H); });
+        }
+    });
+    if (!isDone)
+        return false;
+
+    buff.append("]}");
+    rInOut.Events.clear();  // the osu events, output went to fWrite
+    return fSend();
+}
 
-    strbuff.flush();
-    container.push_back(strbuff.str());  // one line
+
+vector<string> CBsSequencer::serializeBeatset(const NaiSe::BeatSetT& rIn) const
+{
+    vector<string> container(1);
+    serializeBeatset(rIn, container.front());  // one line
     return container;
 }
 
 
+void CBsSequencer::serializeBeatset(const NaiSe::BeatSetT& rIn, string& rOut) const
+{
+    xtrace::CScope trace("serializeBeatset");
+    // Sized for the worst case, never grows while writing
+    rOut.resize(
+        BF_HEADER_MAX + strlen(getVersion()) +
+        rIn.Events.size() * BF_EVENT_MAX +
+        rIn.Targets.size() * BF_TARGET_MAX +
+        rIn.Objects.size() * BF_OBJECT_MAX);
+    char* const pBegin = rOut.data();
+    char* pOut = pBegin;
+
+    // Header
+    pOut = bf_put(pOut, "{\"_version\":\"");
+    pOut = bf_put(pOut, getVersion());
+    pOut = bf_put(pOut, "\",\"_events\":");
+    pOut = bf_appendArray(pOut, rIn.Events, bf_appendEvent);
+    pOut = bf_put(pOut, ",\"_notes\":");
+    pOut = bf_appendArray(pOut, rIn.Targets, bf_appendTarget);
+    pOut = bf_put(pOut, ",\"_obstacles\":");
+    pOut = bf_appendArray(pOut, rIn.Objects, bf_appendObject);
+    pOut = bf_put(pOut, '}');
+
+    assert((size_t)(pOut - pBegin) <= rOut.size());
+    rOut.resize(pOut - pBegin);
+}
+
+
 string CBsSequencer::createMapInfo(const MediaInfoT& rInMeta, BsStageFlagsT stages) const
 {
     stringstream sstr;
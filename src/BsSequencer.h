@@ -3,13 +3,16 @@
 namespace NaiSe {
 struct MediaInfoT;
 struct SettingT;
+struct EntityT;
 //struct BeatSetT
 }
 
 
 #include "Sequencer.h"
 
+#include <functional>
 #include <string>
+#include <string_view>
 //#include <vector>
 
 
@@ -27,11 +30,22 @@ public:
     {
         bool Easy, Normal, Hard, Expert, ExpertPlus;
     };
+    // Hands the hit objects of a map in time order, chunk by chunk, to the function given. False if not all were.
+    using ReplayFunc = std::function<bool(const std::function<bool(const std::vector<NaiSe::EntityT>&)>&)>;
 
     void transformBeatset(NaiSe::BeatSetT& rInOut) final override;
+    // Transforms and serializes an osu set while its hit objects are replayed, without holding them. rInOut keeps
+    // meta and timing only, its name is final before the first piece goes to fWrite. Replays three times, once for
+    // each array of the output; output and transformBeatset followed by serializeBeatset are equal.
+    // False if a replay or fWrite failed.
+    bool streamBeatset(NaiSe::BeatSetT& rInOut, const ReplayFunc& fReplay, const std::function<bool(std::string_view)>& fWrite);
     std::vector<std::string> serializeBeatset(const NaiSe::BeatSetT& rIn) const final override;
+    void serializeBeatset(const NaiSe::BeatSetT& rIn, std::string& rOut) const final override;
     std::string createMapInfo(const NaiSe::MediaInfoT& rInMeta, BsStageFlagsT stages) const;
     
     const char* getVersion() const final override { return "2.0.0"; }
+
+private:
+    void assignMode(NaiSe::BeatSetT& rInOut);  // renames an osu set after the mode it is sequenced to
 };
 
@@ -0,0 +1,222 @@
+#include "ConversionCache.h"
+
+#include <charconv>  // from_chars, to_chars
+#include <cstring>  // strlen
+#include <filesystem>
+#include <fstream>
+
+#include "util/xfile.hpp"
+
+
+using namespace std;
+using namespace NaiSe;
+
+
+namespace {
+
+const char CACHE_HEADER[] = "NaiSeCache 3";  // bump on format change, old files are dropped
+const uint32_t CONVERTER_REVISION = 2u;  // bump whenever the converted output changes, older records then miss
+const size_t CACHE_FIELDS = 10;
+
+// FNV-1a 64
+uint64_t hashBytes(uint64_t hash, string_view bytes) noexcept
+{
+    for (char c : bytes)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Separators are replaced, all records are single-line
+void appendField(string& rOut, string_view field)
+{
+    const auto pos = rOut.size();
+    rOut.append(field);
+    for (auto i=pos; i<rOut.size(); ++i)
+    {
+        if (('\t' == rOut[i]) || ('\n' == rOut[i]) || ('\r' == rOut[i]))
+            rOut[i] = ' ';
+    }
+    rOut += '\t';
+}
+
+template<typename T>
+void appendNumber(string& rOut, T val)
+{
+    char buff[24];
+    auto res = to_chars(buff, buff + sizeof(buff), val);
+    appendField(rOut, string_view(buff, res.ptr - buff));
+}
+
+// Each field ends with a tab. Empty fields are kept, unlike xstring::trySplit
+bool splitRecord(string_view lne, string_view (&rOut)[CACHE_FIELDS])
+{
+    size_t pos;
+    for (auto&& field : rOut)
+    {
+        pos = lne.find('\t');
+        if (string_view::npos == pos)
+            return false;
+
+        field = lne.substr(0, pos);
+        lne.remove_prefix(pos + 1);
+    }
+    return true;
+}
+
+template<typename T>
+bool decodeNumber(string_view field, T& rOut, int base=10)
+{
+    auto res = from_chars(field.data(), field.data() + field.size(), rOut, base);
+    return (errc() == res.ec) && (field.data() + field.size() == res.ptr);
+}
+
+bool decodeNumber(string_view field, float& rOut)
+{
+    auto res = from_chars(field.data(), field.data() + field.size(), rOut);
+    return (errc() == res.ec) && (field.data() + field.size() == res.ptr);
+}
+
+}// anonymous ns
+
+
+uint64_t CConversionCache::makeKey(string_view content, const char* version, uint8_t stage) noexcept
+{
+    uint64_t hash = hashBytes(14695981039346656037ull, content);
+    hash = hashBytes(hash, string_view(version, strlen(version) + 1));  // terminator separates from revision
+    hash = hashBytes(hash, string_view(reinterpret_cast<const char*>(&CONVERTER_REVISION), sizeof(CONVERTER_REVISION)));
+    return hashBytes(hash, string_view(reinterpret_cast<const char*>(&stage), 1));
+}
+
+
+bool CConversionCache::tryHashFile(const string& fullpath, uint64_t& rOut)
+{
+    xfile::CMappedFile file;
+    if (!file.open(fullpath))
+        return false;
+
+    rOut = hashBytes(14695981039346656037ull, file.view());
+    return true;
+}
+
+
+bool CConversionCache::tryMakeKey(const string& fullpath, const char* version, uint8_t stage, uint64_t& rOut)
+{
+    xfile::CMappedFile file;
+    if (!file.open(fullpath))
+        return false;
+
+    rOut = makeKey(file.view(), version, stage);
+    return true;
+}
+
+
+bool CConversionCache::load(const string& fullpath)
+{
+    lock_guard<mutex> lk(mMtx);
+    mEntries.clear();
+    mFilename = fullpath;
+    mIsDirty = false;
+
+    ifstream fs(fullpath);
+    string lne;
+    if (!fs.is_open() || !getline(fs, lne) || (CACHE_HEADER != lne))
+        return false;
+
+    string_view args[CACHE_FIELDS];
+    uint64_t key;
+    unsigned modes;
+    EntryT entry;
+    while (getline(fs, lne))
+    {
+        if (!splitRecord(lne, args) ||
+            !decodeNumber(args[0], key, 16) ||
+            !decodeNumber(args[1], modes) ||
+            !decodeNumber(args[7], entry.Media.PreviewStart_ms) ||
+            !decodeNumber(args[8], entry.Media.AverageRate_bpm) ||
+            !decodeNumber(args[9], entry.Written))
+        {
+            continue;  // damaged record is converted again
+        }
+        entry.Modes = (ISequencer::modeFlag_t)modes;
+        entry.Target = args[2];
+        entry.Media.Artist = args[3];
+        entry.Media.Title = args[4];
+        entry.Media.Author = args[5];
+        entry.Media.Filename = args[6];
+        mEntries[key] = move(entry);
+    }
+    return true;
+}
+
+
+bool CConversionCache::save()
+{
+    lock_guard<mutex> lk(mMtx);
+    if (!mIsDirty || mFilename.empty())
+        return true;
+
+    string buff(CACHE_HEADER);
+    buff += '\n';
+    for (auto&& [key, entry] : mEntries)
+    {
+        char hex[16];
+        auto res = to_chars(hex, hex + sizeof(hex), key, 16);
+        appendField(buff, string_view(hex, res.ptr - hex));
+        appendNumber(buff, (unsigned)entry.Modes);
+        appendField(buff, entry.Target);
+        appendField(buff, entry.Media.Artist);
+        appendField(buff, entry.Media.Title);
+        appendField(buff, entry.Media.Author);
+        appendField(buff, entry.Media.Filename);
+        appendNumber(buff, entry.Media.PreviewStart_ms);
+        appendNumber(buff, entry.Media.AverageRate_bpm);
+        appendNumber(buff, entry.Written);
+        buff += '\n';
+    }
+
+    // Replace at once, an interrupted write leaves the former cache
+    const auto tmpName = mFilename + ".tmp";
+    {
+        ofstream fs(tmpName, ios::binary | ios::trunc);
+        if (!fs.is_open())
+            return false;
+
+        fs.write(buff.data(), buff.size());
+        if (!fs.good())
+            return false;
+    }
+    error_code ec;
+    filesystem::rename(tmpName, mFilename, ec);
+    if (ec)
+        return false;
+
+    mIsDirty = false;
+    return true;
+}
+
+
+bool CConversionCache::tryGet(uint64_t key, EntryT& rOut) const
+{
+    {
+        lock_guard<mutex> lk(mMtx);
+        auto it = mEntries.find(key);
+        if (mEntries.end() == it)
+            return false;
+
+        rOut = it->second;
+    }
+    // Deleted output, or output another input wrote since, is converted again
+    uint64_t written;
+    return tryHashFile(rOut.Target, written) && (rOut.Written == written);
+}
+
+
+void CConversionCache::insert(uint64_t key, EntryT entry)
+{
+    lock_guard<mutex> lk(mMtx);
+    mEntries[key] = move(entry);
+    mIsDirty = true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "Sequencer.h"
+
+
+/// On-disk record of finished conversions, keyed by input content, sequencer version, converter revision and stage.
+/// A record only counts while the map file it names still holds what was written. Thread-safe.
+class CConversionCache
+{
+public:
+    struct EntryT
+    {
+        std::string Target;  // written map file, relative to the working dir
+        ISequencer::modeFlag_t Modes{};
+        NaiSe::MediaInfoT Media;  // for the index file of a beatset
+        uint64_t Written{};  // hash of the map file, by tryHashFile
+    };
+
+private:
+    std::unordered_map<uint64_t, EntryT> mEntries;
+    std::string mFilename;
+    mutable std::mutex mMtx;
+    bool mIsDirty{};
+
+public:
+    static uint64_t makeKey(std::string_view content, const char* version, uint8_t stage) noexcept;
+    static bool tryMakeKey(const std::string& fullpath, const char* version, uint8_t stage, uint64_t& rOut);
+    // Of a map file as written, line breaks of the platform included. False if it can not be read.
+    static bool tryHashFile(const std::string& fullpath, uint64_t& rOut);
+
+    // Missing or unreadable files start an empty cache
+    bool load(const std::string& fullpath);
+    bool save();  // only if changed since load
+    const std::string& getFilename() const { return mFilename; }
+
+    bool tryGet(uint64_t key, EntryT& rOut) const;
+    void insert(uint64_t key, EntryT entry);
+};
@@ -0,0 +1,369 @@
+#include "Daemon.h"
+
+#include <algorithm>  // find_if
+#include <condition_variable>
+#include <cerrno>
+#include <chrono>
+#include <cstring>  // memcpy, memset
+#include <list>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "NaiveSequencer.h"
+#include "util/xthread.hpp"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+using namespace std;
+
+
+#ifndef _WIN32
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;  // a gone peer must not end the process
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+bool readAll(int fd, void* pOut, size_t len)
+{
+    auto p = static_cast<char*>(pOut);
+    while (len)
+    {
+        const auto n = ::recv(fd, p, len, 0);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* pIn, size_t len)
+{
+    auto p = static_cast<const char*>(pIn);
+    while (len)
+    {
+        const auto n = ::send(fd, p, len, SEND_FLAGS);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool makeAddress(const string& socketPath, sockaddr_un& rOut)
+{
+    memset(&rOut, 0, sizeof(rOut));
+    rOut.sun_family = AF_UNIX;
+    if (socketPath.empty() || (socketPath.size() >= sizeof(rOut.sun_path)))
+        return false;
+
+    memcpy(rOut.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return true;
+}
+
+/// Connection shared by its reader and the workers answering it
+struct ConnectionT
+{
+    int fd;
+    mutex WriteMtx;  // answers are written whole
+    mutex Mtx;
+    condition_variable CvPending;
+    size_t Pending{};
+
+    explicit ConnectionT(int sock) : fd(sock) {}
+    ~ConnectionT() { ::close(fd); }
+
+    void answer(const DaemonResponseT& res, const string& name, const string& map, const string& info)
+    {
+        lock_guard<mutex> lk(WriteMtx);
+        writeAll(fd, &res, sizeof(res)) &&
+            writeAll(fd, name.data(), name.size()) &&
+            writeAll(fd, map.data(), map.size()) &&
+            writeAll(fd, info.data(), info.size());  // a failed write ends the reader soon
+    }
+};
+
+/// Thread reading a connection, joined once it has reported its end
+struct ReaderT
+{
+    thread Th;
+    weak_ptr<ConnectionT> pConn;  // to shut it down
+};
+
+const auto ACCEPT_RETRY_DELAY = chrono::milliseconds(100);  // until descriptors are released
+
+}// anonymous ns
+#endif
+
+
+CConversionDaemon::CConversionDaemon(const NaiSe::CBeatTranslator& translator, unsigned jobs, size_t maxPending, uint32_t maxSize,
+    size_t maxConnections, size_t maxBuffered) :
+    mTranslator(translator),
+    mJobs(jobs),
+    mMaxPending(max<size_t>(1, maxPending)),
+    mMaxSize(maxSize),
+    mMaxConnections(max<size_t>(1, maxConnections)),
+    mMaxBuffered(max<size_t>(maxSize, maxBuffered))  // any request fits once the others are answered
+{}
+
+
+bool CConversionDaemon::run(const string& socketPath)
+{
+#ifdef _WIN32
+    (void)socketPath;
+    return false;  // unsupported on Windows
+#else
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr))
+        return false;
+
+    const int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0)
+        return false;
+
+    ::unlink(socketPath.c_str());
+    if ((0 != ::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) || (0 != ::listen(lfd, 64)))
+    {
+        ::close(lfd);
+        return false;
+    }
+
+    const auto& bt = mTranslator;
+    const size_t maxPending = mMaxPending;
+    const uint32_t maxSize = mMaxSize;
+    const size_t maxBuffered = mMaxBuffered;
+    mutex mtx;
+    condition_variable cvBuffered;
+    condition_variable cvReaders;
+    size_t buffered{};  // bytes of unanswered requests
+    size_t readerCnt{};  // connections open for reading
+    vector<thread::id> finished;  // readers to join
+
+    auto fRelease = [&mtx, &cvBuffered, &buffered](size_t len) {
+        {
+            lock_guard<mutex> lk(mtx);
+            buffered -= len;
+        }
+        cvBuffered.notify_all();
+    };
+
+    auto fAnswer = [&bt, &fRelease](const shared_ptr<ConnectionT>& pConn, uint32_t id, uint8_t stage, const vector<char>& content) {
+        DaemonResponseT res;
+        string name, map, info;
+        try
+        {
+            res.IsOk = bt.convertBuffer({ content.data(), content.size() }, stage, map, info, name) ? 1 : 0;
+        } catch (const exception&) {}
+        res.Id = id;
+        res.NameSize = (uint32_t)name.size();
+        res.MapSize = (uint32_t)map.size();
+        res.InfoSize = (uint32_t)info.size();
+        pConn->answer(res, name, map, info);
+        fRelease(content.size());
+        {
+            lock_guard<mutex> lk(pConn->Mtx);
+            --pConn->Pending;
+        }
+        pConn->CvPending.notify_all();
+    };
+
+    xthread::CWorkerPool pool(mJobs);  // gone before fAnswer, which its tasks call
+
+    auto fRead = [&, maxPending, maxSize, maxBuffered](shared_ptr<ConnectionT> pConn) {
+        DaemonRequestT req;
+        const string none;
+        while (readAll(pConn->fd, &req, sizeof(req)) && (DaemonRequestT::MAGIC == req.Magic))
+        {
+            DaemonResponseT rejected;
+            rejected.Id = req.Id;
+            if (req.Size > maxSize)
+            {// the content is not read, the stream can not be resumed
+                pConn->answer(rejected, none, none, none);
+                break;
+            }
+            {
+                unique_lock<mutex> lk(pConn->Mtx);
+                pConn->CvPending.wait(lk, [&] { return pConn->Pending < maxPending; });
+            }
+            {// reserved before the content is allocated
+                unique_lock<mutex> lk(mtx);
+                cvBuffered.wait(lk, [&] { return buffered + req.Size <= maxBuffered; });
+                buffered += req.Size;
+            }
+            auto pContent = make_shared<vector<char>>(req.Size);
+            if (!readAll(pConn->fd, pContent->data(), pContent->size()))
+            {
+                fRelease(req.Size);
+                break;
+            }
+
+            if (req.Stage > NaiSe::CBeatTranslator::MAX_STAGE_LEVEL)
+            {
+                pConn->answer(rejected, none, none, none);
+                fRelease(req.Size);
+                continue;
+            }
+
+            {
+                lock_guard<mutex> lk(pConn->Mtx);
+                ++pConn->Pending;  // only this reader adds
+            }
+            pool.submit([&fAnswer, pConn, pContent, id = req.Id, stage = req.Stage] { fAnswer(pConn, id, stage, *pContent); });
+        }
+        ::shutdown(pConn->fd, SHUT_RD);  // closed when the last answer is written
+        {
+            lock_guard<mutex> lk(mtx);
+            --readerCnt;
+            finished.push_back(this_thread::get_id());
+        }
+        cvReaders.notify_all();
+    };
+
+    list<ReaderT> readers;
+    auto fJoinFinished = [&]() {
+        vector<thread::id> ids;
+        {
+            lock_guard<mutex> lk(mtx);
+            ids.swap(finished);
+        }
+        for (auto&& id : ids)
+        {
+            auto it = find_if(readers.begin(), readers.end(), [id](const ReaderT& rd) { return id == rd.Th.get_id(); });
+            if (readers.end() != it)
+            {
+                it->Th.join();
+                readers.erase(it);
+            }
+        }
+    };
+
+    const size_t maxConnections = mMaxConnections;
+    for (;;)
+    {
+        {// the backlog holds further connections
+            unique_lock<mutex> lk(mtx);
+            cvReaders.wait(lk, [&] { return readerCnt < maxConnections; });
+        }
+        fJoinFinished();
+        const int fd = ::accept(lfd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if ((EINTR == errno) || (ECONNABORTED == errno))
+                continue;  // the listener is fine
+            if ((EMFILE == errno) || (ENFILE == errno) || (ENOBUFS == errno) || (ENOMEM == errno))
+            {// out of descriptors or memory while connections are open
+                this_thread::sleep_for(ACCEPT_RETRY_DELAY);
+                continue;
+            }
+            break;
+        }
+        auto pConn = make_shared<ConnectionT>(fd);
+        readers.emplace_back();
+        try
+        {
+            {
+                lock_guard<mutex> lk(mtx);
+                ++readerCnt;
+            }
+            readers.back().Th = thread(fRead, pConn);
+            readers.back().pConn = pConn;
+        } catch (const system_error&) {// out of threads, the connection is closed
+            {
+                lock_guard<mutex> lk(mtx);
+                --readerCnt;
+            }
+            readers.pop_back();
+            this_thread::sleep_for(ACCEPT_RETRY_DELAY);
+        }
+    }
+    ::close(lfd);
+
+    // Readers and answers use the state of this call, requests read are still answered
+    for (auto&& rd : readers)
+    {
+        if (auto pConn = rd.pConn.lock())
+            ::shutdown(pConn->fd, SHUT_RD);
+    }
+    for (auto&& rd : readers)
+    {
+        rd.Th.join();
+    }
+    return false;  // the pool answers what was read before it is gone
+#endif
+}
+
+
+bool CDaemonClient::connect(const string& socketPath)
+{
+    close();
+#ifdef _WIN32
+    (void)socketPath;
+    return false;
+#else
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr))
+        return false;
+
+    mFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((mFd >= 0) && (0 == ::connect(mFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))))
+        return true;
+
+    close();
+    return false;
+#endif
+}
+
+
+bool CDaemonClient::send(uint32_t id, uint8_t stage, string_view content)
+{
+#ifdef _WIN32
+    return false;
+#else
+    DaemonRequestT req;
+    req.Id = id;
+    req.Stage = stage;
+    req.Size = (uint32_t)content.size();
+    return (mFd >= 0) && writeAll(mFd, &req, sizeof(req)) && writeAll(mFd, content.data(), content.size());
+#endif
+}
+
+
+bool CDaemonClient::receive(uint32_t& rId, bool& rIsOk, string& rName, string& rMap, string& rInfo)
+{
+#ifdef _WIN32
+    return false;
+#else
+    DaemonResponseT res;
+    if ((mFd < 0) || !readAll(mFd, &res, sizeof(res)))
+        return false;
+
+    rId = res.Id;
+    rIsOk = (0 != res.IsOk);
+    rName.resize(res.NameSize);
+    rMap.resize(res.MapSize);
+    rInfo.resize(res.InfoSize);
+    return readAll(mFd, rName.data(), rName.size()) && readAll(mFd, rMap.data(), rMap.size()) && readAll(mFd, rInfo.data(), rInfo.size());
+#endif
+}
+
+
+void CDaemonClient::close()
+{
+#ifndef _WIN32
+    if (mFd >= 0)
+        ::close(mFd);
+#endif
+    mFd = -1;
+}
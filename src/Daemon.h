@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace NaiSe {
+class CBeatTranslator;
+}
+
+
+/// Wire format of the conversion daemon, in host byte order. Every request is answered once.
+/// Answers to pipelined requests come in order of completion and are matched by id.
+struct DaemonRequestT
+{
+    static const uint32_t MAGIC = 0x6553614Eu;  // "NaSe"
+
+    uint32_t Magic{MAGIC};
+    uint32_t Id{};
+    uint32_t Size{};  // of the .osu content that follows
+    uint8_t  Stage{};  // 0 for a loose map, else 1 to 9 like the single-pass options, others fail
+};
+
+struct DaemonResponseT
+{
+    uint32_t Id{};
+    uint32_t NameSize{};  // followed by map name, map and index
+    uint32_t MapSize{};
+    uint32_t InfoSize{};
+    uint8_t  IsOk{};
+};
+
+
+/// Serves conversions of a resident translator on a Unix domain socket, POSIX only.
+/// Each connection is read on its own thread, conversions run on a shared pool of workers.
+class CConversionDaemon
+{
+    const NaiSe::CBeatTranslator& mTranslator;
+    unsigned mJobs;
+    size_t   mMaxPending;
+    uint32_t mMaxSize;
+    size_t   mMaxConnections;
+    size_t   mMaxBuffered;
+
+public:
+    // Zero jobs uses all cores. Reading a connection pauses while maxPending of its requests are unanswered,
+    // reading any pauses while the unanswered requests of all hold maxBuffered bytes, at least maxSize.
+    // A request of more than maxSize bytes is answered as failed and its connection dropped.
+    // Connections beyond maxConnections wait in the backlog of the socket.
+    CConversionDaemon(const NaiSe::CBeatTranslator& translator, unsigned jobs=0u, size_t maxPending=64u, uint32_t maxSize=32u << 20,
+        size_t maxConnections=256u, size_t maxBuffered=size_t{256} << 20);
+
+    // Replaces an existing socket file. Returns only on failure, after the requests read are answered.
+    bool run(const std::string& socketPath);
+};
+
+
+/// Blocking client of CConversionDaemon. Requests can be sent ahead of reading their answers.
+class CDaemonClient
+{
+    int mFd{-1};
+
+public:
+    CDaemonClient() = default;
+    CDaemonClient(const CDaemonClient&) = delete;
+    CDaemonClient& operator=(const CDaemonClient&) = delete;
+    ~CDaemonClient() { close(); }
+
+    bool connect(const std::string& socketPath);
+    bool send(uint32_t id, uint8_t stage, std::string_view content);
+    // Next answer, outputs are overwritten. False if the connection is lost.
+    bool receive(uint32_t& rId, bool& rIsOk, std::string& rName, std::string& rMap, std::string& rInfo);
+    void close();
+};
@@ -1,19 +1,38 @@
+#include <algorithm>  // stable_sort, clamp
 #include <filesystem>
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <exception>  // exception_ptr
+#include <thread>  // hardware_concurrency
+#include <iostream>  // cerr
+#include <functional>
 
 #include "NaiveSequencer.h"
 #include "Beatmap.h"
 #include "OsuParser.h"
+#include "BsParser.h"
 #include "BsSequencer.h"
+#include "ConversionCache.h"
 
 #include "common.hpp"
 #include "util/xstring.hpp"
+#include "util/xmemory.hpp"
+#include "util/xthread.hpp"
+#include "util/xtrace.hpp"
+#include "util/xwatch.hpp"
+#include "util/xzip.hpp"
 
 
 using namespace std;
 
 
 namespace {
-vector<NaiSe::BeatSetT> sMaps{};
+
+// Maps from this size on are parsed while read, without keeping their lines. Single-pass conversions also
+// transform and write them chunk by chunk, queued sets hold them whole.
+const uintmax_t STREAM_MIN_SIZE = 32u << 20;
 
 bool tryMakeFoldername(
     const string& artist,
@@ -38,12 +57,194 @@ namespace stdfs = filesystem;
 using namespace NaiSe;
 
 
-BeatSetT CBeatTranslator::loadFile(const char* fullpath) const
+namespace {
+
+// Stages of at most five maps of a beatset, in order of their overall difficulty. Each map gets the stage
+// of its rating (two points per stage), moved up or down as far as needed to give all maps distinct stages.
+// Maps left out of a larger set are listed on stderr.
+vector<pair<Difficulty_t, string>> rankByDifficulty(vector<pair<float, string>> maps)
+{
+    sort(maps.begin(), maps.end());
+    if (maps.size() > 5)
+    {// spread over the range
+        vector<pair<float, string>> picks;
+        string skipped;
+        for (size_t i=0, next=0; i<maps.size(); ++i)
+        {
+            if ((next < 5) && (i == next * (maps.size() - 1) / 4))
+            {
+                picks.push_back(move(maps[i]));
+                ++next;
+            } else {
+                skipped += maps[i].second + " exceeds the five stages of its beatset and has been skipped.\n";
+            }
+        }
+        cerr << skipped << flush;  // one write, sets are ranked concurrently
+        maps.swap(picks);
+    }
+
+    vector<pair<Difficulty_t, string>> ranks;
+    int last = -1;
+    const int cnt = (int)maps.size();
+    for (int i=0; i<cnt; ++i)
+    {
+        int stage = clamp((int)(maps[i].first / 2.f), 0, 4);
+        stage = min(max(stage, last + 1), 4 - (cnt - 1 - i));
+        ranks.emplace_back(static_cast<Difficulty_t>(stage), move(maps[i].second));
+        last = stage;
+    }
+    return ranks;
+}
+
+// Files below a folder, or matching the file name pattern below its folder
+vector<string> findBeatmaps(const char* pathOrPattern)
+{
+    error_code ec;
+    stdfs::path root(pathOrPattern);
+    string pattern("*.osu");
+    if (!stdfs::is_directory(root, ec))
+    {
+        pattern = root.filename().string();
+        root = root.has_parent_path() ? root.parent_path() : stdfs::path(".");
+    }
+
+    vector<string> files;
+    for (stdfs::recursive_directory_iterator it(root, stdfs::directory_options::skip_permission_denied, ec), end; !ec && (it != end); it.increment(ec))
+    {
+        if (it->is_regular_file(ec) && xstring::matchWildcard(it->path().filename().string(), pattern))
+            files.push_back(it->path().string());
+    }
+    return files;
+}
+
+// Index file of the staged maps in dir
+void writeIndex(const stdfs::path& dir, const MediaInfoT& media, const bool (&st)[5], ISequencer::modeFlag_t modes)
+{
+    CBsSequencer seq;
+    seq.setMode(modes);
+    vector<string> infostr;
+    infostr.emplace_back(seq.createMapInfo(media, CBsSequencer::BsStageFlagsT{ st[0], st[1], st[2], st[3], st[4] }));
+    CBeatmap info(move(infostr), GameTypes_t::beatsaber);
+    info.writeMap((dir / "Info").string());
+}
+
+// Relative folder named after the beatset, created if missing. Empty path (working dir) on failure.
+stdfs::path makeOutputDir(const MediaInfoT& media)
+{
+    string subdir;
+    if (tryMakeFoldername(media.Artist, media.Title, media.Author, subdir))
+    {
+        stdfs::path dir(subdir);  // relative
+        error_code ec;
+        stdfs::create_directory(dir, ec);  // may race with other workers, existing is fine
+        if (stdfs::is_directory(dir, ec))
+            return dir;
+    }
+    return {};
+}
+
+// Converts an osu map from STREAM_MIN_SIZE on chunk by chunk, read once for meta and timing and once more for each
+// array of the output. False if the map is smaller or no such map, or its hit objects are out of time order;
+// it is to be loaded whole then. rIsWritten tells if its map file rOutName (without extention) was written,
+// fClaim can refuse the name.
+bool tryStreamFile(
+    const char*                         fullpath,
+    uint8_t                             stage,
+    CBsSequencer&                       rSeq,
+    BeatSetT&                           rOut,
+    string&                             rOutName,
+    bool&                               rIsWritten,
+    const function<bool(const string&)>& fClaim={})
+{
+    error_code ec;
+    if ((stdfs::path(fullpath).extension() == ".dat") || (stdfs::file_size(fullpath, ec) < STREAM_MIN_SIZE) || ec)
+        return false;
+
+    float tLast{};
+    const bool isSorted = COsuParser::tryParseStream(fullpath, rOut, [&tLast](const vector<EntityT>& chunk) {
+        for (auto&& en : chunk)
+        {
+            if (en.SpawnTime < tLast)
+                return false;  // the sequencer reads ahead in time order only
+            tLast = en.SpawnTime;
+        }
+        return true;
+    });
+    if (!isSorted || (GameTypes_t::osu != rOut.Game))
+        return false;
+
+    rOut.StageLevel = stage;
+    ofstream fs;
+    auto fReplay = [fullpath](const function<bool(const vector<EntityT>&)>& fChunk) {
+        BeatSetT data;
+        return COsuParser::tryParseStream(fullpath, data, fChunk, COsuParser::ParseFlagsT::TARGETS);
+    };
+    auto fWrite = [&](string_view piece) {
+        if (!fs.is_open())
+        {// named by the sequencer before the first piece
+            rOutName = (makeOutputDir(rOut.Media) / rOut.Setting.MapName).string();
+            if (fClaim && !fClaim(rOutName + ".dat"))
+                return false;
+            if (!(fs = CBeatmap::openMap(rOutName, rOut.Game)).is_open())
+                return false;
+        }
+        fs.write(piece.data(), piece.size());
+        xtrace::count("bytes written", (int64_t)piece.size());
+        return fs.good();
+    };
+    rIsWritten = rSeq.streamBeatset(rOut, fReplay, fWrite);
+    if (fs.is_open())
+    {
+        fs << '\n';
+        fs.close();
+        rIsWritten &= !fs.fail();
+    }
+    return true;
+}
+
+}// anonymous ns
+
+
+CBeatTranslator::CBeatTranslator() = default;
+
+
+CBeatTranslator::~CBeatTranslator()
+{
+    if (mpCache)
+        mpCache->save();
+}
+
+
+bool CBeatTranslator::setCache(const char* fullpath)
+{
+    if (mpCache)
+        mpCache->save();
+
+    if (!fullpath || !*fullpath)
+    {
+        mpCache.reset();
+        return true;
+    }
+    if (!mpCache)
+        mpCache = make_unique<CConversionCache>();
+    return mpCache->load(fullpath);
+}
+
+
+BeatSetT CBeatTranslator::loadFile(const char* fullpath, bool useMapping) const
 {
+    xtrace::CScope trace("loadFile");
     CBeatmap file;
     BeatSetT data;
-    if (file.initFromPath(string{fullpath}))
-    {
+    error_code ec;
+    if (filesystem::path(fullpath).extension() == ".dat")
+    {// sequenced before, taken as is by the sequencer
+        if (CBsParser::tryParseFile(fullpath, data))
+            return data;
+    } else if ((filesystem::file_size(fullpath, ec) >= STREAM_MIN_SIZE) && !ec) {
+        if (COsuParser::tryParseStream(fullpath, data))
+            return data;
+    } else if (file.initFromPath(string{fullpath}, useMapping)) {
         if (COsuParser::tryParse(file, data))
             return data;
     }
@@ -52,119 +253,637 @@ BeatSetT CBeatTranslator::loadFile(const char* fullpath) const
 }
 
 
+bool CBeatTranslator::readInfo(const char* fullpath, BeatmapInfoT& rOut) const
+{
+    return readInfo(fullpath, rOut, true);
+}
+
+
+bool CBeatTranslator::readInfo(const char* fullpath, BeatmapInfoT& rOut, bool useMapping) const
+{
+    const uint8_t flags = COsuParser::ParseFlagsT::MEDIA | COsuParser::ParseFlagsT::TIMING;
+    CBeatmap file;
+    BeatSetT data;
+    if (!fullpath || !file.initFromPath(fullpath, useMapping, COsuParser::stopTag(flags)) || !COsuParser::tryParse(file, data, flags))
+        return false;
+
+    rOut.Artist = move(data.Media.Artist);
+    rOut.Title = move(data.Media.Title);
+    rOut.Creator = move(data.Media.Author);
+    rOut.AverageRate_bpm = data.Media.AverageRate_bpm;
+    rOut.OverallDifficulty = data.Setting.Rating;
+    return true;
+}
+
+
+size_t CBeatTranslator::convertTree(const char* pathOrPattern, unsigned jobs) const
+{
+    if (!pathOrPattern || !*pathOrPattern)
+        return 0;
+
+    auto files = findBeatmaps(pathOrPattern);
+
+    // Group by output folder, as the single-pass translations name it
+    map<string, vector<pair<float, string>>> sets;
+    for (auto&& file : files)
+    {
+        BeatmapInfoT info;
+        string dir;
+        if (readInfo(file.c_str(), info) && tryMakeFoldername(info.Artist, info.Title, info.Creator, dir))
+            sets[dir].emplace_back(info.OverallDifficulty, move(file));
+    }
+
+    atomic<size_t> converted{};
+    {
+        xthread::CWorkerPool pool(jobs);
+        for (auto&& [dir, maps] : sets)
+        {
+            pool.submit([&converted, &maps = maps] {
+                try
+                {
+                    CBeatTranslator bt;
+                    size_t cnt{};
+                    for (auto&& [stage, file] : rankByDifficulty(maps))
+                    {
+                        cnt += bt.appendFile(file.c_str(), stage) ? 1 : 0;
+                    }
+                    bt.translate(1u);  // sets run concurrently already
+                    converted += cnt;
+                } catch (const exception&) {}  // skip beatset
+            });
+        }
+    }// drained and joined
+    return converted;
+}
+
+
 void CBeatTranslator::convertFile(const char* fullpath, uint8_t stage) const
 {
     CBsSequencer seq;
-    auto data = loadFile(fullpath);
-    data.StageLevel = stage;
+    CConversionCache::EntryT entry;
+    uint64_t key{};
+    const bool useCache = mpCache && CConversionCache::tryMakeKey(fullpath, seq.getVersion(), stage, key);
+    if (useCache && mpCache->tryGet(key, entry))
+        return;  // unchanged
 
-    switch (data.Game)
+    xmemory::CScratchScope scratch;  // released after writing
+    BeatSetT data;
+    string name;
+    bool isWritten{};
+    if (!tryStreamFile(fullpath, stage, seq, data, name, isWritten))
     {
-    case GameTypes_t::osu:
-        //pSeq = make_unique<CBsSequencer>();
-        seq.transformBeatset(data);
-        break;
+        data = loadFile(fullpath);
+        data.StageLevel = stage;
 
-    case GameTypes_t::beatsaber:
-        // TODO implement internal mode-to-mode translation
-        return;
-        break;
+        switch (data.Game)
+        {
+        case GameTypes_t::osu:
+        case GameTypes_t::beatsaber:  // rewritten with its own mode
+            //pSeq = make_unique<CBsSequencer>();
+            seq.transformBeatset(data);
+            break;
+
+        default:
+            throw logic_error("NaiveSequencer::translateToBsFile(...) - Unsupported game type");
+            break;
+        }
 
-    default:
-        throw logic_error("NaiveSequencer::translateToBsFile(...) - Unsupported game type");
-        break;
+        string buff;
+        name = (makeOutputDir(data.Media) / data.Setting.MapName).string();
+        seq.serializeBeatset(data, buff);
+        isWritten = CBeatmap::writeMap(name, data.Game, buff);
     }
-    
-    CBeatmap bsFile(seq.serializeBeatset(data), data.Game);
-    string subdir;
-    if (tryMakeFoldername(data.Media.Artist, data.Media.Title, data.Media.Author, subdir))
+    uint64_t written;
+    if (isWritten && useCache && CConversionCache::tryHashFile(name + ".dat", written))
+        mpCache->insert(key, { name + ".dat", seq.getMode(), move(data.Media), written });
+}
+
+
+size_t CBeatTranslator::convertBatch(const vector<pair<string, uint8_t>>& files, unsigned jobs) const
+{
+    struct FolderT
     {
-        stdfs::path dir(subdir);  // relative
-        if (stdfs::exists(dir) || stdfs::create_directory(dir))
+        size_t      FirstIndex{SIZE_MAX};  // keeps media of the first file by input order
+        MediaInfoT  Media;
+        bool        Stages[5]{};
+        ISequencer::modeFlag_t Modes{};
+    };
+
+    map<string, FolderT> folders;  // by output folder
+    set<string> targets;  // map files written by this batch
+    mutex mtx;
+    atomic<size_t> converted{};
+
+    // Concurrent writes to one file could interleave, the first input resolving to it keeps it
+    auto fClaim = [&](const string& target) {
+        lock_guard<mutex> lk(mtx);
+        return targets.insert(target).second;
+    };
+
+    auto fStage = [&](size_t i, const string& dir, const MediaInfoT& media, ISequencer::modeFlag_t modes) {
+        const uint8_t stage = files[i].second;
+        lock_guard<mutex> lk(mtx);
+        auto& folder = folders[dir];
+        if (i < folder.FirstIndex)
         {
-            bsFile.writeMap((dir /= data.Setting.MapName).string());
+            folder.FirstIndex = i;
+            folder.Media = media;
+        }
+        if (stage)
+            folder.Stages[min(stage >> 1, 4)] = true;
+        folder.Modes |= modes;
+    };
+
+    auto fConvert = [&](size_t i) noexcept {
+        try
+        {
+            CBsSequencer seq;
+            CConversionCache::EntryT entry;
+            uint64_t key{};
+            const bool useCache = mpCache && CConversionCache::tryMakeKey(files[i].first, seq.getVersion(), files[i].second, key);
+            if (useCache && mpCache->tryGet(key, entry))
+            {// unchanged, the index file still needs its media
+                if (!fClaim(entry.Target))
+                    return;
+                ++converted;
+                fStage(i, stdfs::path(entry.Target).parent_path().string(), entry.Media, entry.Modes);
+                return;
+            }
+
+            xmemory::CScratchScope scratch;
+            BeatSetT data;
+            string name;
+            bool isWritten{};
+            if (!tryStreamFile(files[i].first.c_str(), files[i].second, seq, data, name, isWritten, fClaim))
+            {
+                data = loadFile(files[i].first.c_str());
+                data.StageLevel = files[i].second;
+                seq.transformBeatset(data);
+                name = (makeOutputDir(data.Media) / data.Setting.MapName).string();
+                string buff;
+                seq.serializeBeatset(data, buff);
+                isWritten = fClaim(name + ".dat") && CBeatmap::writeMap(name, data.Game, buff);
+            }
+            if (!isWritten)
+                return;
+            ++converted;
+
+            fStage(i, stdfs::path(name).parent_path().string(), data.Media, seq.getMode());
+            uint64_t written;
+            if (useCache && CConversionCache::tryHashFile(name + ".dat", written))
+                mpCache->insert(key, { name + ".dat", seq.getMode(), move(data.Media), written });
+        } catch (const exception&) {}  // skip file
+    };
+
+    {
+        xthread::CWorkerPool pool(jobs);
+        set<pair<string, uint8_t>> queued;
+        for (size_t i=0; i<files.size(); ++i)
+        {
+            if (queued.emplace(stdfs::path(files[i].first).lexically_normal().string(), files[i].second).second)
+                pool.submit([&fConvert, i] { fConvert(i); });  // repeated inputs would write the same file
+        }
+    }// drained and joined
+    if (mpCache)
+        mpCache->save();
+
+    for (auto&& [dir, folder] : folders)
+    {
+        const auto& st = folder.Stages;
+        if (!(st[0] || st[1] || st[2] || st[3] || st[4]))
+            continue;  // loose maps only
+
+        writeIndex(dir, folder.Media, st, folder.Modes);
+    }
+    return converted;
+}
+
+
+bool CBeatTranslator::watchTree(const char* dir) const
+{
+    struct WatchedT
+    {
+        string      Set;  // output folder
+        float       Rating{};
+        int         Stage{-1};  // by Difficulty_t, negative if left out
+        MediaInfoT  Media;
+        ISequencer::modeFlag_t Modes{};
+        string      Target;  // written map file, empty if none
+        stdfs::file_time_type Written;  // of the map read last
+    };
+
+    xwatch::CDirWatcher watcher;
+    if (!dir || !watcher.open(dir))
+        return false;
+
+    map<string, WatchedT> maps;  // by path
+    vector<string> stale;  // map files of former stages or sets
+
+    // Map files no watched map writes any more
+    auto fRemoveStale = [&maps, &stale]() {
+        for (auto&& target : stale)
+        {
+            error_code ec;
+            if (none_of(maps.cbegin(), maps.cend(), [&target](const auto& en) { return target == en.second.Target; }))
+                stdfs::remove(target, ec);
+        }
+        stale.clear();
+    };
+
+    auto fConvert = [this, &stale](const string& path, WatchedT& rMap) {
+        try
+        {
+            xmemory::CScratchScope scratch;
+            const auto stage = (uint8_t)(2 * rMap.Stage + 1);
+            CBsSequencer seq;
+            BeatSetT data;
+            string name;
+            bool isWritten{};
+            if (!tryStreamFile(path.c_str(), stage, seq, data, name, isWritten))
+            {
+                data = loadFile(path.c_str(), false);
+                data.StageLevel = stage;
+                if (GameTypes_t::osu != data.Game)
+                    return;
+
+                string buff;
+                seq.transformBeatset(data);
+                seq.serializeBeatset(data, buff);
+                name = (makeOutputDir(data.Media) / data.Setting.MapName).string();
+                CBeatmap::writeMap(name, data.Game, buff);
+            }
+            if (!rMap.Target.empty() && (name + ".dat" != rMap.Target))
+                stale.push_back(rMap.Target);  // stage, mode or set moved
+            rMap.Target = name + ".dat";
+            rMap.Media = move(data.Media);
+            rMap.Modes = seq.getMode();
+        } catch (const exception&) {}  // keep former state
+    };
+
+    auto fWriteIndex = [&maps](const string& set) {
+        bool st[5]{};
+        const WatchedT* pFirst = nullptr;
+        ISequencer::modeFlag_t modes{};
+        for (auto&& [path, en] : maps)
+        {
+            if ((set != en.Set) || (en.Stage < 0))
+                continue;
+
+            st[en.Stage] = true;
+            modes |= en.Modes;
+            if (!pFirst || (en.Stage < pFirst->Stage))
+                pFirst = &en;  // media of the lowest rank
+        }
+        error_code ec;
+        if (pFirst)
+            writeIndex(set, pFirst->Media, st, modes);
+        else
+            stdfs::remove(stdfs::path(set) / "Info.dat", ec);  // no map left
+    };
+
+    // Ranks a set again, converts its maps with a new stage and the changed one
+    auto fRefresh = [&](const string& set, const string& changed) {
+        vector<pair<float, string>> ratings;
+        for (auto&& [path, en] : maps)
+        {
+            if (set == en.Set)
+                ratings.emplace_back(en.Rating, path);
+        }
+        auto ranks = rankByDifficulty(move(ratings));
+        for (auto&& [path, en] : maps)
+        {
+            if (set != en.Set)
+                continue;
+
+            auto it = find_if(ranks.cbegin(), ranks.cend(), [&path = path](const auto& rk) { return path == rk.second; });
+            const int stage = (ranks.cend() != it) ? (int)it->first : -1;
+            const bool isMoved = (stage != en.Stage);
+            en.Stage = stage;
+            if ((0 <= stage) && (isMoved || (path == changed)))
+            {
+                fConvert(path, en);
+            } else if ((stage < 0) && !en.Target.empty()) {// left out of the set
+                stale.push_back(en.Target);
+                en.Target.clear();
+            }
+        }
+        fWriteIndex(set);
+    };
+
+    auto fRemove = [&](const string& path) {
+        auto it = maps.find(path);
+        if (maps.end() == it)
             return;
+
+        const string set = it->second.Set;
+        if (!it->second.Target.empty())
+            stale.push_back(it->second.Target);
+        maps.erase(it);
+        fRefresh(set, {});
+    };
+
+    auto fUpdate = [&](const string& path) {
+        BeatmapInfoT info;
+        string set;
+        if (!readInfo(path.c_str(), info, false) || !tryMakeFoldername(info.Artist, info.Title, info.Creator, set))
+            return;  // not a beatmap, or not written completely
+
+        error_code ec;
+        auto& en = maps[path];
+        const string former = en.Set;
+        en.Written = stdfs::last_write_time(path, ec);
+        const bool isRanked = (former == set) && (en.Rating == info.OverallDifficulty) && (0 <= en.Stage);
+        en.Set = set;
+        en.Rating = info.OverallDifficulty;
+        if (isRanked)
+        {// the common case, an edit of notes or timing
+            fConvert(path, en);
+            fWriteIndex(set);
+            return;
+        }
+        if (!former.empty() && (former != set))
+            fRefresh(former, path);
+        fRefresh(set, path);
+    };
+
+    // A folder gone takes the maps below it along
+    auto fRemoveBelow = [&](const string& path) {
+        vector<string> gone;
+        for (auto&& [mapPath, en] : maps)
+        {
+            if ((mapPath.size() > path.size()) && !mapPath.compare(0, path.size(), path) && stdfs::path::preferred_separator == mapPath[path.size()])
+                gone.push_back(mapPath);
+        }
+        for (auto&& mapPath : gone)
+        {
+            fRemove(mapPath);
+        }
+    };
+
+    // Compares the whole folder after changes were lost
+    auto fRescan = [&]() {
+        auto files = findBeatmaps(dir);
+        sort(files.begin(), files.end());
+        vector<string> gone;
+        for (auto&& [path, en] : maps)
+        {
+            if (!binary_search(files.cbegin(), files.cend(), path))
+                gone.push_back(path);
+        }
+        for (auto&& path : gone)
+        {
+            fRemove(path);
+        }
+        for (auto&& path : files)
+        {
+            error_code ec;
+            auto it = maps.find(path);
+            if ((maps.end() == it) || (it->second.Written != stdfs::last_write_time(path, ec)))
+                fUpdate(path);
+        }
+    };
+
+    for (auto&& path : findBeatmaps(dir))
+    {
+        BeatmapInfoT info;
+        string set;
+        if (readInfo(path.c_str(), info, false) && tryMakeFoldername(info.Artist, info.Title, info.Creator, set))
+        {
+            auto& en = maps[path];
+            error_code ec;
+            en.Set = move(set);
+            en.Rating = info.OverallDifficulty;
+            en.Written = stdfs::last_write_time(path, ec);
         }
     }
-    bsFile.writeMap(data.Setting.MapName);
+    {
+        vector<string> sets;
+        for (auto&& [path, en] : maps)
+        {
+            sets.push_back(en.Set);
+        }
+        sort(sets.begin(), sets.end());
+        sets.erase(unique(sets.begin(), sets.end()), sets.end());
+        for (auto&& set : sets)
+        {
+            fRefresh(set, {});
+        }
+    }
+
+    vector<string> changed;
+    bool isOverflow{};
+    while (watcher.wait(changed, isOverflow))
+    {// an editor may write a file more than once
+        sort(changed.begin(), changed.end());
+        changed.erase(unique(changed.begin(), changed.end()), changed.end());
+        for (auto&& path : changed)
+        {
+            error_code ec;
+            const bool isMap = xstring::matchWildcard(stdfs::path(path).filename().string(), "*.osu");
+            if (stdfs::exists(path, ec))
+            {
+                if (isMap)
+                    fUpdate(path);
+            } else if (isMap) {
+                fRemove(path);  // deleted or moved away
+            } else {
+                fRemoveBelow(path);  // maybe a folder
+            }
+        }
+        if (isOverflow)
+            fRescan();
+        fRemoveStale();
+        changed.clear();
+    }
+    return false;
 }
 
 
-bool CBeatTranslator::appendFile(const char* fullpath, Difficulty_t stage)
+bool CBeatTranslator::convertBuffer(string_view content, uint8_t stage, string& rOutMap, string& rOutInfo, string& rOutName) const
 {
-    try
+    rOutMap.clear();
+    rOutInfo.clear();
+    rOutName.clear();
+    if (stage > MAX_STAGE_LEVEL)
+        return false;  // no such stage name
+
+    xmemory::CScratchScope scratch;
+    CBeatmap file;
+    BeatSetT data;
+    if (!file.initFromView(content, "memory.osu") || !COsuParser::tryParse(file, data))
+        return false;
+
+    data.StageLevel = stage;
+    CBsSequencer seq;
+    seq.transformBeatset(data);
+    seq.serializeBeatset(data, rOutMap);
+    rOutName = move(data.Setting.MapName);
+    if (stage)
     {
-        sMaps.push_back(loadFile(fullpath));
-    } catch (exception ex) { return false; }
+        bool st[5]{};
+        st[stage >> 1] = true;
+        rOutInfo = seq.createMapInfo(data.Media, CBsSequencer::BsStageFlagsT{ st[0], st[1], st[2], st[3], st[4] });
+    }
+    return !rOutMap.empty();
+}
+
+
+bool CBeatTranslator::appendBeatset(BeatSetT&& data, Difficulty_t stage)
+{
+    const auto iStage = (size_t)stage;
+    if ((iStage < size(mAvailableStages)) && mAvailableStages[iStage])
+        return false;  // would be translated concurrently to the same file
 
     switch (stage)
     {
     case Difficulty_t::easy:
         mAvailableStages[0] = true;
-        sMaps.back().StageLevel = 1;
+        data.StageLevel = 1;
         break;
 
     case Difficulty_t::normal:
         mAvailableStages[1] = true;
-        sMaps.back().StageLevel = 3;
+        data.StageLevel = 3;
         break;
 
     case Difficulty_t::hard:
         mAvailableStages[2] = true;
-        sMaps.back().StageLevel = 5;
+        data.StageLevel = 5;
         break;
 
     case Difficulty_t::extra:
         mAvailableStages[3] = true;
-        sMaps.back().StageLevel = 7;
+        data.StageLevel = 7;
         break;
 
     case Difficulty_t::special:
         mAvailableStages[4] = true;
-        sMaps.back().StageLevel = 9;
+        data.StageLevel = 9;
         break;
 
     default:
-        sMaps.pop_back();
         return false;
     }
+    mMaps.push_back(move(data));
     return true;
 }
 
 
+bool CBeatTranslator::appendFile(const char* fullpath, Difficulty_t stage)
+{
+    try
+    {
+        xmemory::CScratchScope scratch;
+        return appendBeatset(loadFile(fullpath), stage);
+    } catch (const exception&) { return false; }
+}
+
+
+size_t CBeatTranslator::appendArchive(const char* fullpath)
+{
+    xfile::CMappedFile file;
+    xzip::CZipReader zip;
+    if (!fullpath || !file.open(fullpath) || !zip.open(file.view()))
+        return 0;
+
+    vector<BeatSetT> sets;
+    for (auto&& en : zip.entries())
+    {
+        if (!xstring::endsWithNoCase(en.Name, ".osu"))
+            continue;  // audio, images, storyboards
+
+        try
+        {
+            xmemory::CScratchScope scratch;
+            vector<char> content;
+            CBeatmap map;
+            BeatSetT data;
+            if (zip.extract(en, content) &&
+                map.initFromBuffer(move(content), en.Name) &&
+                COsuParser::tryParse(map, data))
+            {
+                sets.push_back(move(data));
+            }
+        } catch (const exception&) {}  // skip entry, the others may still be fine
+    }
+
+    // Denser maps get higher ranks of those still free, ranks above special are dropped
+    stable_sort(sets.begin(), sets.end(), [](const BeatSetT& a, const BeatSetT& b) { return a.Targets.size() < b.Targets.size(); });
+    size_t cnt{};
+    size_t stage{};
+    for (auto&& data : sets)
+    {
+        while ((stage < size(mAvailableStages)) && mAvailableStages[stage])
+            ++stage;
+        if (!appendBeatset(move(data), static_cast<Difficulty_t>(stage)))
+            break;
+        ++cnt;
+    }
+    return cnt;
+}
+
+
 void CBeatTranslator::clear()
 {
-    sMaps.clear();
+    mMaps.clear();
     memset(mAvailableStages, false, sizeof(mAvailableStages));
 }
 
 
-void CBeatTranslator::translate()
+void CBeatTranslator::translate(unsigned jobs)
 {
-    if (sMaps.empty())
+    if (mMaps.empty())
         return;
 
-    CBsSequencer seq;
     stdfs::path root;
-    const BeatSetT& cont = sMaps.front();
-    string subdir;
+    const BeatSetT& cont = mMaps.front();
+
+    root = makeOutputDir(cont.Media);
+
+    // Difficulties share nothing but the index, each has its own sequencer and modes
+    vector<ISequencer::modeFlag_t> modes(mMaps.size());
+    vector<exception_ptr> errors(mMaps.size());
+    auto fTranslate = [&](size_t i) noexcept {
+        try
+        {
+            xmemory::CScratchScope scratch;
+            CBsSequencer seq;
+            string buff;
+            auto& map = mMaps[i];
+            seq.transformBeatset(map);  // changes map name too
+            seq.serializeBeatset(map, buff);
+            CBeatmap::writeMap((root/map.Setting.MapName).string(), map.Game, buff);  // names are referenced in map info!
+            modes[i] = seq.getMode();
+        } catch (...) {
+            errors[i] = current_exception();
+        }
+    };
 
-    if (tryMakeFoldername(cont.Media.Artist, cont.Media.Title, cont.Media.Author, subdir))
+    const unsigned threads = min<unsigned>(jobs ? jobs : max(1u, thread::hardware_concurrency()), (unsigned)mMaps.size());
+    if (1u == threads)
     {
-        stdfs::path dir(subdir);  // relative
-        if (stdfs::exists(dir) || stdfs::create_directory(dir))
+        for (size_t i=0; i<mMaps.size(); ++i)
+        {
+            fTranslate(i);
+        }
+    } else {
+        xthread::CWorkerPool pool(threads);
+        for (size_t i=0; i<mMaps.size(); ++i)
         {
-            root = dir;
+            pool.submit([&fTranslate, i] { fTranslate(i); });
         }
+    }// drained and joined
+    for (auto&& err : errors)
+    {
+        if (err)
+            rethrow_exception(err);
     }
-    
-    for (auto&& map : sMaps)
+
+    CBsSequencer seq;
+    for (auto mode : modes)
     {
-        seq.transformBeatset(map);  // changes map name too
-        CBeatmap bsFile(seq.serializeBeatset(map), map.Game);
-        bsFile.writeMap((root/map.Setting.MapName).string());  // names are referenced in map info!
+        seq.setMode(seq.getMode() | mode);
     }
-    
     vector<string> infostr;
     infostr.emplace_back(
         seq.createMapInfo(
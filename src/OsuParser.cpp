@@ -2,33 +2,63 @@
 #include "Beatmap.h"
 
 #include <cstdlib> // abs
-#include <regex>
+#include <cctype>  // isalnum
 #include <algorithm>  // find_if...
-#include <unordered_map>
-#include <set>
+#include <charconv>  // from_chars
+#include <functional>
 
 #include "common.hpp"
+#include "util/xmemory.hpp"
 #include "util/xstring.hpp"
+#include "util/xtrace.hpp"
 
 
 using namespace std;
 using namespace NaiSe;
 using namespace std::string_literals;
-using IndexDict = unordered_map<string, pair<int, size_t>>;
 
 
 namespace{
 
+enum class Section_t : uint8_t
+{
+    setting = 0,
+    editor,
+    media,
+    complexity,
+    trigger,
+    timing,
+    target,
+    _size
+};
+
 struct Tags
 {
-    inline static const std::string Osu_Setting{"[General]"};
-    inline static const std::string Osu_Media{"[Metadata]"};
-    inline static const std::string Osu_Complexity{"[Difficulty]"};
-    inline static const std::string Osu_Trigger{"[Events]"};
-    inline static const std::string Osu_Timing{"[TimingPoints]"};
-    inline static const std::string Osu_Target{"[HitObjects]"};
+    static constexpr string_view Osu_Setting{"[General]"};
+    static constexpr string_view Osu_Editor{"[Editor]"};
+    static constexpr string_view Osu_Media{"[Metadata]"};
+    static constexpr string_view Osu_Complexity{"[Difficulty]"};
+    static constexpr string_view Osu_Trigger{"[Events]"};
+    static constexpr string_view Osu_Timing{"[TimingPoints]"};
+    static constexpr string_view Osu_Target{"[HitObjects]"};
+
+    // by order of Section_t
+    static constexpr string_view All[] = {
+        Osu_Setting, Osu_Editor, Osu_Media, Osu_Complexity, Osu_Trigger, Osu_Timing, Osu_Target
+    };
+};
+static_assert(size(Tags::All) == enum_cast(Section_t::_size), "Each section needs a tag");
+
+struct SectionT
+{
+    size_t First{SIZE_MAX};  // line of the tag
+    size_t Last{};  // line before next tag or last line
+
+    bool isValid() const { return SIZE_MAX != First; }
 };
 
+using SectionIndex = xarr<Section_t, SectionT>;
+
 struct Properties
 {
     static constexpr auto const Osu_iLeadIn{"AudioLeadIn"};
@@ -67,221 +97,389 @@ enum class HitIndex : uint8_t
     soundId,
     attrib
 };
+const size_t HIT_FIELDS_MAX = 12;  // slider lines have 11
 
-// Using regex to trim whitespace
-string str_trim(const string& str)
+enum class FieldError_t : uint8_t
 {
-    // removes \r\n\t\f\v at begin and end of string
-    return regex_replace(str, regex("(^\\s+)|(\\s+$)"), string(""), regex_constants::match_any | regex_constants::match_not_null);
+    none = 0,
+    missing,  // no such field
+    invalid,  // no number at begin of field
+    range     // number does not fit
+};
+
+// Behaves like stoi/stof: leading whitespace and plus sign are skipped, trailing characters ignored.
+// rOut is left unchanged on error.
+template<typename T>
+FieldError_t decodeField(string_view field, T& rOut) noexcept
+{
+    size_t pos = field.find_first_not_of(" \t\r\n\f\v");
+    if (string_view::npos == pos)
+        return FieldError_t::invalid;
+
+    if (('+' == field[pos]) && (++pos < field.length()) && ('-' == field[pos]))
+        return FieldError_t::invalid;
+
+    auto res = from_chars(field.data() + pos, field.data() + field.length(), rOut);
+    switch (res.ec)
+    {
+    case errc::invalid_argument:
+        return FieldError_t::invalid;
+
+    case errc::result_out_of_range:
+        return FieldError_t::range;
+
+    default:
+        return FieldError_t::none;
+    }
+}
+
+template<typename TArgs, typename TEnum, typename T>
+FieldError_t decodeField(const TArgs& args, TEnum idx, T& rOut) noexcept
+{
+    return (enum_cast(idx) < args.size()) ? decodeField(args[enum_cast(idx)], rOut) : FieldError_t::missing;
+}
+
+// Matches "^\s*\[\w+\]" and returns the tag including brackets
+bool tryGetTag(string_view lne, string_view& rOutTag)
+{
+    size_t spos = lne.find_first_not_of(" \t\r\n\f\v");
+    if (string_view::npos == spos || '[' != lne[spos])
+        return false;
+
+    size_t epos = spos + 1;
+    while (epos < lne.length() && (isalnum(static_cast<unsigned char>(lne[epos])) || '_' == lne[epos]))
+        ++epos;
+
+    if ((spos + 1 == epos) || (lne.length() <= epos) || (']' != lne[epos]))
+        return false;
+
+    rOutTag = lne.substr(spos, epos - spos + 1);
+    return true;
 }
 
-// Using regex to detect (only) osu tags
-IndexDict mapTags(const StringSequenceT& rInSeq)
+// Single sweep over all lines. Each tag closes the section opened before, unknown tags included.
+// The sweep ends at stopTag, if given.
+SectionIndex mapTags(const StringSequenceT& rInSeq, string_view stopTag)
 {
-    size_t lneNo=0;
-    int elNo = 0;
-    IndexDict dic;
-    smatch match;
-    regex pattern("^\\s*\\[\\w+\\]");  // first alphanumeric characters enclosed in brackets
+    size_t lneNo = 0;
+    SectionIndex dic;
+    SectionT unknown;
+    SectionT* pOpen = nullptr;
+    string_view tag;
 
-    for (auto it=rInSeq.Begin; it!=rInSeq.End; ++it)
+    for (auto it=rInSeq.Begin; it!=rInSeq.End; ++it, ++lneNo)
     {
-        if (regex_search(*it, match, pattern))
+        if (!tryGetTag(*it, tag))
+            continue;
+
+        if (tag == stopTag)
+            break;
+
+        if (pOpen)
+            pOpen->Last = lneNo - 1;
+
+        pOpen = &unknown;
+        for (size_t i=0; i<dic.size(); ++i)
         {
-            dic[match.str()] = make_pair(elNo, lneNo);
-            ++elNo;
+            if (Tags::All[i] == tag)
+            {
+                pOpen = &dic[i];
+                break;
+            }
         }
-        ++lneNo;
+        pOpen->First = lneNo;  // a repeated tag overrides the former
     }
+    if (pOpen)
+        pOpen->Last = lneNo - 1;
     return dic;
 }
 
-auto getMappedPair(const IndexDict& map, const string& key)
+// FNV-1a
+constexpr uint32_t hashKey(string_view key) noexcept
 {
-    auto kvpIt = map.find(key);
-    if (map.end() != kvpIt)
+    uint32_t hash = 2166136261u;
+    for (char c : key)
     {
-        return kvpIt->second;
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
     }
-    return pair<int, size_t>(-1, 0);  // no match
+    return hash;
 }
 
-size_t getNextMappedLine(const IndexDict& map, int n)
+struct PropertyT
 {
-    assert(!map.empty());
-    if (n<0)
-        n = 0;
-    /*return (++n < map.size()) ?
-        next(map.cbegin(), n)->second.second :
-        SIZE_MAX;  // last mapped line*/
-    if (++n < map.size())
+    uint32_t    Hash{};
+    string_view Key;
+    string_view Value;  // trimmed, can be empty
+};
+
+/// Flat index of a "Key: Value" section, built once and searched by key hash.
+class PropertyIndex
+{
+    pmr::vector<PropertyT> mItems{xmemory::CScratchScope::scratch()};
+
+public:
+    PropertyIndex() = default;
+
+    explicit PropertyIndex(const StringSequenceT& rInSeq)
     {
-        for (auto&& kvp : map)
-        {// keyValuePair.Value.MapIndex | LineIndex
-            if (n == kvp.second.first)
-                return kvp.second.second;
+        size_t pos;
+        string_view key;
+
+        mItems.reserve(rInSeq.Distance);
+        for (auto it=rInSeq.Begin; it!=rInSeq.End; ++it)
+        {
+            if (string_view::npos == (pos = it->find(':')))
+                continue;  // tag or blank line
+
+            key = xstring::trimView(it->substr(0, pos));
+            if (!key.empty())
+            {
+                mItems.push_back({ hashKey(key), key, xstring::trimView(it->substr(pos + 1)) });
+            }
         }
     }
-    return SIZE_MAX;  // no match or last line
-}
 
-string getStrAttribute(const StringSequenceT& rInSrc, const char* property)
-{
-    auto lneIt = find_if(rInSrc.Begin, rInSrc.End, [property](const string& str) {
-        return string::npos != str.find(property);
-    });
-    if (rInSrc.End != lneIt)  // if no match, last is returned
+    // First value of key, empty if there is none
+    string_view find(string_view key) const noexcept
     {
-        auto offs = (*lneIt).find(':') + 1;
-        if (offs < (*lneIt).length())
+        const auto hash = hashKey(key);
+        for (auto&& item : mItems)
         {
-            return str_trim((*lneIt).substr(offs));
+            if ((hash == item.Hash) && (key == item.Key))
+                return item.Value;
         }
-
+        return {};
     }
-    return string{};
+};
+
+PropertyIndex indexProperties(const StringSequenceT& rInSeq, const SectionT& sec)
+{
+    return sec.isValid() ? PropertyIndex(rInSeq.make_subsequence(sec.First, sec.Last)) : PropertyIndex{};
 }
 
 template<typename T>
-T getAttribute_(const StringSequenceT& rInSrc, const char* property, T nullValue) noexcept { return nullValue; }
+T getAttribute_(const PropertyIndex& rInSrc, const char* property, T nullValue) noexcept { return nullValue; }
 
 template<>
-string getAttribute_<string>(const StringSequenceT& rInSrc, const char* property, string nullValue)  noexcept
+string getAttribute_<string>(const PropertyIndex& rInSrc, const char* property, string nullValue)  noexcept
 {
-    string str = getStrAttribute(rInSrc, property);
-    return (str.empty() ? nullValue : str);
+    auto str = rInSrc.find(property);
+    return (str.empty() ? nullValue : string(str));
 }
 
 template<>
-int getAttribute_<int>(const StringSequenceT& rInSrc, const char* property, int nullValue) noexcept
+int getAttribute_<int>(const PropertyIndex& rInSrc, const char* property, int nullValue) noexcept
 { 
-    try
-    {
-        return stoi(getStrAttribute(rInSrc, property));
-    } catch (exception ex) {
-        return nullValue;
-    }
+    int val;
+    return (FieldError_t::none == decodeField(rInSrc.find(property), val)) ? val : nullValue;
 }
 
 template<>
-float getAttribute_<float>(const StringSequenceT& rInSrc, const char* property, float nullValue) noexcept
+float getAttribute_<float>(const PropertyIndex& rInSrc, const char* property, float nullValue) noexcept
 { 
-    try
+    float val;
+    return (FieldError_t::none == decodeField(rInSrc.find(property), val)) ? val : nullValue;
+}
+
+// Beat duration of the segment lasting longest until tEnd_ms. The last segment counts only if it ends after its start.
+float evaluateTiming(const vector<TimingT>& timing, float tEnd_ms)
+{
+    assert(!timing.empty()); // must have at least one
+    float val = timing.front().Period_ms;
+    float longest = -1.f;
+    for (size_t i=0; i<timing.size(); ++i)
     {
-        return stof(getStrAttribute(rInSrc, property));
-    } catch (exception ex) {
-        return nullValue;
+        const float tStop = (i + 1 < timing.size()) ? timing[i + 1].Start_ms : max(tEnd_ms, timing[i].Start_ms);
+        if (longest < tStop - timing[i].Start_ms)
+        {
+            longest = tStop - timing[i].Start_ms;
+            val = timing[i].Period_ms;
+        }
     }
+    return val;
 }
 
-float commonUnit(float a, float b)
+}// anonymous namespace
+
+
+namespace {
+
+/// Values carried from one timing point to the next
+struct TimingStateT
 {
-    if (a == 0) return abs(b);
-    if (b == 0) return abs(a);
-    do {
-        if (b > a)
-            swap(a, b);
-    } while ((b>1.f) && (abs(a -= b) > FLT_EPSILON));
-    return abs(b);
-}
+    float BaseVal{1.f};
+    float LastVal{1.f};
+    bool  State{};
+};
 
-float evaluateTiming(const vector<EventT>& events)
+// One timing point into events and beat grid
+void assignTimingLine(string_view lne, TimingStateT& rState, vector<EventT>& rOut, vector<TimingT>& rOutGrid)
 {
-    set<float> periods;
-    for (auto it=events.cbegin(); it!=events.cend(); ++it)
+    xstring::fields<enum_cast(TimingIndex_t::_size)> args;
+    EventT ev;
+    tick_t tMs;
+    int iEvent;
+
+    // assuming no commentary is found here
+    if (!xstring::trySplit(lne, args, ','))
+        return;
+
+    if ((FieldError_t::none != decodeField(args, TimingIndex_t::timestamp, tMs)) ||  // fractions of older formats are cut off
+        (FieldError_t::none != decodeField(args, TimingIndex_t::timePerBeat, ev.Value)))
     {
-        if (EventType_t::shift == it->EventType)
-            periods.insert(it->Value);
+        return;
     }
-    assert(!periods.empty()); // must have at least one
-    float val = 0;
-    if (!periods.empty())
-        val = *periods.cbegin();
-    for (auto it= ++periods.cbegin(); it!=periods.cend(); ++it)
+    ev.Timestamp = (float)tMs;
+    if (ev.Value < 0)
     {
-        val = commonUnit(val, *it);
+        ev.Value = abs(ev.Value) / 100.f * rState.BaseVal;
+    } else {
+        rState.BaseVal = ev.Value;
+        if (ev.Value > 1)
+        {// shorter beats are no grid, quantizing would divide by them
+            if (!rOutGrid.empty() && (ev.Timestamp == rOutGrid.back().Start_ms))
+                rOutGrid.back().Period_ms = ev.Value;  // last of equal timestamps wins, like the events
+            else
+                rOutGrid.push_back({ ev.Timestamp, ev.Value });
+        }
+    }
+
+    if (FieldError_t::none != decodeField(args, TimingIndex_t::kiaiState, iEvent))
+    {// older formats end before effects
+        iEvent = 0;
     }
-    if (val < 200.f)// shortest possible beat duration (300bpm)
+    if (!rState.State && (bool)iEvent)  // on rising
     {
-        val = find_if( events.cbegin(), events.cend(), [ ](EventT evi) {
-            return evi.EventType == EventType_t::shift;
-        })->Value;  //return first beat duration
+        ev.EventType = EventType_t::kiai;
+        rState.State = true;
+    } else if (  // bpm or kiai changed
+        (rState.State != (bool)iEvent) ||
+        (FLT_EPSILON < abs(ev.Value-rState.LastVal)))
+    {
+        rState.LastVal = ev.Value;  // always beat duration
+        rState.State = (iEvent == (int)EventType_t::kiai);
+        ev.EventType = EventType_t::shift;
+    } else {
+        ev.EventType = EventType_t::ignore;
     }
-    return val;
-}
 
-}// anonymous namespace
+    if (!rOut.empty() && tMs == (tick_t)rOut.back().Timestamp)  // whole ms, exact in float
+    {
+        if (ev.EventType == EventType_t::ignore)
+            return;
 
+        rOut.back() = ev;  // re-evaluated and overwritten by order of read-in
+    } else {
+        rOut.push_back(ev);  // is not cleared before appending;
+    }
+    assert(rOut.empty() ? ev.Timestamp >= 0 : ev.Timestamp >= rOut.back().Timestamp);  // timestamps must appear sorted ascendingly
+}
 
- // events
-bool assignFromSequence(const StringSequenceT& rInSeq, vector<EventT>& rOut)
+// One hit object into rInOutObj, which is reused from line to line. False if the line holds none.
+bool assignTargetLine(string_view lne, EntityT& rInOutObj)
 {
-    if (!rInSeq.Distance)
+    xstring::fields<HIT_FIELDS_MAX> args;
+    xstring::fields<2> hold;  // end time and remaining sample set
+    auto& obj = rInOutObj;
+    int iVal[3];
+    float fVal[2];
+    tick_t tMs[2];  // start and end
+
+    // assuming no commentary is found here
+    if (!xstring::trySplit(lne, args, ','))
+        return false;
+
+    if (any_of(args.cbegin(), args.cend() - 1,
+        [](string_view sx) { return string_view::npos != sx.find('-'); }))  // no negative values, excludig attributes part
     {
         return false;
     }
-
-    xvec<TimingIndex_t, string> args;
-    EventT ev;
-    float baseVal=1.f;
-    float lastVal = baseVal;
-    bool state = false;
-    int iEvent;
-
-    assert(rInSeq.Distance <= rOut.max_size());
-    rOut.reserve(rInSeq.Distance);
-
-    // optional: check kind of header - Events OR TimingPoints
-    for (auto it=rInSeq.Begin+1; it!=rInSeq.End; ++it)  // skip header
+    if ((FieldError_t::none != decodeField(args, HitIndex::loc_x, iVal[0])) ||
+        (FieldError_t::none != decodeField(args, HitIndex::loc_y, iVal[1])) ||
+        (FieldError_t::none != decodeField(args, HitIndex::timestamp, tMs[0])) ||  // may repeat
+        (FieldError_t::none != decodeField(args, HitIndex::typeId, iVal[2])))
     {
-        // assuming no commentary is found here
-        if (xstring::trySplit(*it, args, ','))
+        return false;
+    }
+    obj.SpawnTime = (float)tMs[0];
+    assert(UINT8_MAX >= iVal[2]);  // within expected range
+    obj.Location.first = min(Os_Map_Width, (uint16_t)iVal[0]);
+    obj.Location.second = min(Os_Map_Height, (uint16_t)iVal[1]);
+    obj.Type.RawType = (uint8_t)(0xFF & iVal[2]);  // trimmed if over 255
+
+    if (obj.Type.OsuType.IsContinous)
+    {// try get hold-duration
+        if (xstring::trySplit(args.back(), hold, ':'))
         {
-            assert((uint8_t)TimingIndex_t::_size <= args.size());
-            try
-            {
-                ev.Timestamp = stof(args[TimingIndex_t::timestamp]);
-                ev.Value = stof(args[TimingIndex_t::timePerBeat]);
-            } catch (exception ex) { continue; }
-            if (ev.Value < 0)
+            if (FieldError_t::none == decodeField(hold.front(), tMs[1]))  // end of hold timestamp
             {
-                ev.Value = abs(ev.Value) / 100.f * baseVal;
+                obj.Value = (float)tMs[1];
             } else {
-                baseVal = ev.Value;
+                obj.Type.OsuType.IsContinous = false;
+                obj.Value = 0.f;
             }
-
-            try
-            {
-                iEvent = stoi(args[TimingIndex_t::kiaiState]);
-            } catch (exception ex) { iEvent = 0; }
-            if (!state && (bool)iEvent)  // on rising
-            {
-                ev.EventType = EventType_t::kiai;
-                state = true;
-            } else if (  // bpm or kiai changed
-                (state != (bool)iEvent) ||
-                (FLT_EPSILON < abs(ev.Value-lastVal)))
+        } else {
+            obj.Type.OsuType.IsContinous = false;
+        }
+    } else if (obj.Type.OsuType.IsSlider) {
+        if (args.size() > 7)
+        {
+            // slider size in pixel: repetitions * lenght
+            if ((FieldError_t::none == decodeField(args[enum_cast(HitIndex::attrib) + 1], fVal[0])) &&
+                (FieldError_t::none == decodeField(args[enum_cast(HitIndex::attrib) + 2], fVal[1])))
             {
-                lastVal = ev.Value;  // always beat duration
-                state = (iEvent == (int)EventType_t::kiai);
-                ev.EventType = EventType_t::shift;
+                obj.Value = fVal[0] * fVal[1];
             } else {
-                ev.EventType = EventType_t::ignore;
+                obj.Type.OsuType.IsSlider = false;
+                obj.Value = 0;
             }
+        }else {
+            return false;
+        }
+    }else if (obj.Type.OsuType.IsSpin) {
+        if (FieldError_t::none == decodeField(args, HitIndex::attrib, tMs[1]))  // end of spin timestamp
+        {
+            obj.Value = (float)tMs[1];
+        } else {
+            obj.Type.OsuType.IsSpin = false;
+            obj.Value = 0;
+        }
+    } else {
+        if (FieldError_t::none == decodeField(args, HitIndex::soundId, iVal[0]))
+        {
+            assert(UINT8_MAX >= iVal[0]);  // within expected range
+            obj.Value = (float)(0xFF & iVal[0]);  // hit sound id
+        } else {
+            obj.Value = 0;
+        }
+    }
 
-            if (!rOut.empty() && ev.Timestamp == rOut.back().Timestamp)
-            {
-                if (ev.EventType == EventType_t::ignore)
-                    continue;
+    // is: exactly one of a kind or combo start
+    return obj.Type.OsuType.IsComboStart || (obj.Type.OsuType.IsCircle ^ obj.Type.OsuType.IsSlider ^ obj.Type.OsuType.IsSpin ^ obj.Type.OsuType.IsContinous);
+}
+
+}// anonymous namespace
 
-                rOut.back() = ev;  // re-evaluated and overwritten by order of read-in
-            } else {
-                rOut.push_back(ev);  // is not cleared before appending;
-            }
-            assert(rOut.empty() ? ev.Timestamp >= 0 : ev.Timestamp >= rOut.back().Timestamp);  // timestamps must appear sorted ascendingly
 
-        }// split
-    }// loop lines
+ // events and beat grid
+bool assignFromSequence(const StringSequenceT& rInSeq, vector<EventT>& rOut, vector<TimingT>& rOutGrid)
+{
+    if (!rInSeq.Distance)
+    {
+        return false;
+    }
+
+    TimingStateT state;
+    assert(rInSeq.Distance <= rOut.max_size());
+    rOut.reserve(rInSeq.Distance);
+    rOutGrid.reserve(rInSeq.Distance);
+
+    // optional: check kind of header - Events OR TimingPoints
+    for (auto it=rInSeq.Begin+1; it!=rInSeq.End; ++it)  // skip header
+    {
+        assignTimingLine(*it, state, rOut, rOutGrid);
+    }
      // has at least one beat duration over 1ms
     return !rOut.empty() && (rOut.front().Value > 1);  // can be external contents
 }
@@ -295,117 +493,36 @@ bool assignFromSequence(const StringSequenceT& rInSeq, vector<EntityT>& rOut)
         return false;
     }
 
-    xvec<HitIndex, string> args;
     EntityT obj;
-
     assert(rInSeq.Distance <= rOut.max_size());
     rOut.reserve(rInSeq.Distance);
 
     for (auto it=rInSeq.Begin+1; it!=rInSeq.End; ++it)  // skip header
     {
-        // assuming no commentary is found here
-        if (xstring::trySplit(*it, args, ','))
-        {
-            if (any_of(args.cbegin(), args.cend() - 1,
-                [](string sx) { return xstring::contains(sx, "-"); }))  // no negative values, excludig attributes part
-            {
-                continue;
-            }
-            assert(UINT8_MAX >= stoi(args[HitIndex::typeId]));  // within expected range
-            try
-            {
-                obj.Location.first = min(Os_Map_Width, (uint16_t)stoi(args[HitIndex::loc_x]));
-                obj.Location.second = min(Os_Map_Height, (uint16_t)stoi(args[HitIndex::loc_y]));
-                obj.SpawnTime = stof(args[HitIndex::timestamp]);  // may repeat
-                obj.Type.RawType = (uint8_t)(0xFF & stoi(args[HitIndex::typeId]));  // trimmed if over 255
-            } catch (exception e) { continue; }
-
-            if (obj.Type.OsuType.IsContinous)
-            {// try get hold-duration
-                if(xstring::trySplit(string(args.back()), args, ':'))  // args is initially cleared on call. does not work inplace if rIn references a element of args
-                {
-                    try
-                    {
-                        obj.Value = stof(args.front());  // end of hold timestamp
-                    } catch (exception ex) {
-                        obj.Type.OsuType.IsContinous = false;
-                        obj.Value = 0.f;
-                    }
-                } else {
-                    obj.Type.OsuType.IsContinous = false;
-                }
-            } else if (obj.Type.OsuType.IsSlider) {
-                if (args.size() > 7)
-                {
-                    try
-                    {
-                        // slider size in pixel: repetitions * lenght
-                        obj.Value = stof(args[enum_cast(HitIndex::attrib) + 1]) * stof(args[enum_cast(HitIndex::attrib) + 2]);
-                    }
-                    catch (exception e) {
-                        obj.Type.OsuType.IsSlider = false;
-                        obj.Value = 0;
-                    }
-                }else {
-                    continue;
-                }
-            }else if (obj.Type.OsuType.IsSpin) {
-                try
-                {
-                    obj.Value = stof(args[HitIndex::attrib]);  // end of spin timestamp
-                }
-                catch (exception e) {
-                    obj.Type.OsuType.IsSpin = false;
-                    obj.Value = 0;
-                }
-            } else {
-                try
-                {
-                    assert(UINT8_MAX >= stoi(args[HitIndex::soundId]));  // within expected range
-                    obj.Value = (float)(0xFF & stoi(args[HitIndex::soundId]));  // hit sound id
-                } catch (exception e) { obj.Value = 0; }
-            }
-
-            if (!obj.Type.OsuType.IsComboStart && !(obj.Type.OsuType.IsCircle ^ obj.Type.OsuType.IsSlider ^ obj.Type.OsuType.IsSpin ^ obj.Type.OsuType.IsContinous))
-                continue;  // is not: exactly one of a kind or combo start
-
+        if (assignTargetLine(*it, obj))
             rOut.push_back(obj);
-        }// split
-    }// loop lines
+    }
     return rOut.size();
 }
 
 
-bool COsuParser::tryParse(const CBeatmap& rIn, BeatSetT& rOut)
-{// rIn must remain unchanged for the duration of the call!
-    if (GameTypes_t::osu != rIn.getGameType() || !rIn.isValid())
-    {// Understands only osu beatmap
-        return false;
-    }
-    
-    auto seq = rIn.getSequence();
-    if (seq.isEmpty())
-    {
-        return false;
-    }
-
-    const auto dic = mapTags(seq);
-    pair<int, size_t> idxPair;  // first: element iteration by order of read-in; second: file line number
-    bool pass = true;
-
+// General, editor, difficulty and metadata sections
+bool assignHeader(const StringSequenceT& seq, const SectionIndex& dic, const string& mapName, BeatSetT& rOut)
+{
     // General
     rOut.Game = GameTypes_t::osu;
-    rOut.Setting.SubgridSize = getAttribute_<int>(seq, Properties::Osu_iSubgridSize, 8);
-    if (0 <= (idxPair = getMappedPair(dic, Tags::Osu_Setting)).first)
+    rOut.Setting.SubgridSize = ticksPerBeat(getAttribute_<int>(indexProperties(seq, dic[Section_t::editor]), Properties::Osu_iSubgridSize, 8));
+    if (const auto& sec = dic[Section_t::setting]; sec.isValid())
     {
-        StringSequenceT subSeq = seq.make_subsequence(idxPair.second, getNextMappedLine(dic, idxPair.first));
+        StringSequenceT subSeq = seq.make_subsequence(sec.First, sec.Last);
         if (subSeq.Distance)
         {
-            rOut.Setting.MapName = rIn.getFilename();
-            rOut.Media.Filename = getStrAttribute(subSeq, Properties::Osu_sMediaName);
-            rOut.Media.PreviewStart_ms = getAttribute_<int>(subSeq, Properties::Osu_iPreviewStart, 0);
-            rOut.Setting.LeadIn_ms = getAttribute_<int>(subSeq, Properties::Osu_iLeadIn, 0);
-            switch (getAttribute_<int>(subSeq, Properties::Osu_iMode, -1))
+            const PropertyIndex props(subSeq);
+            rOut.Setting.MapName = mapName;
+            rOut.Media.Filename = getAttribute_<string>(props, Properties::Osu_sMediaName, "");
+            rOut.Media.PreviewStart_ms = getAttribute_<int>(props, Properties::Osu_iPreviewStart, 0);
+            rOut.Setting.LeadIn_ms = getAttribute_<int>(props, Properties::Osu_iLeadIn, 0);
+            switch (getAttribute_<int>(props, Properties::Osu_iMode, -1))
             {
             case 3:
                 rOut.Setting.Mode = GameMode_t::os_mania;
@@ -421,44 +538,241 @@ bool COsuParser::tryParse(const CBeatmap& rIn, BeatSetT& rOut)
             }
         }
     }
-    pass &=
+    const bool pass =
         !(xstring::isEmptyOrWhitespace(&(rOut.Media.Filename)) ||
         (rOut.Setting.Mode == GameMode_t::undefined) ||
             xstring::isEmptyOrWhitespace(&(rOut.Setting.MapName)));
 
+    rOut.Setting.Rating = getAttribute_<float>(indexProperties(seq, dic[Section_t::complexity]), Properties::Osu_fStage, 0.f);
+
     // Metadata
-    if (0 <= (idxPair = getMappedPair(dic, Tags::Osu_Media)).first)
+    if (const auto& sec = dic[Section_t::media]; sec.isValid())
     {
-        StringSequenceT subSeq = seq.make_subsequence(idxPair.second, getNextMappedLine(dic, idxPair.first));
+        StringSequenceT subSeq = seq.make_subsequence(sec.First, sec.Last);
         if (subSeq.Distance)
         {
-            rOut.Media.Title = getStrAttribute(subSeq, Properties::Osu_sTitle);
-            rOut.Media.Artist = getStrAttribute(subSeq, Properties::Osu_sArtist);
-            rOut.Media.Author = getStrAttribute(subSeq, Properties::Osu_sAuthor);
+            const PropertyIndex props(subSeq);
+            rOut.Media.Title = getAttribute_<string>(props, Properties::Osu_sTitle, "");
+            rOut.Media.Artist = getAttribute_<string>(props, Properties::Osu_sArtist, "");
+            rOut.Media.Author = getAttribute_<string>(props, Properties::Osu_sAuthor, "");
         }
     }
+    return pass;
+}
+
+
+namespace {
+
+const size_t STREAM_CHUNK_TARGETS = 4096;  // hit objects handed on at once
+
+using ChunkFunc = function<bool(const vector<EntityT>&)>;
+
+/// Takes streamed lines section by section. Lines of the small property sections are kept for assignHeader,
+/// timing points and hit objects are decoded as they pass, events and unknown sections are skipped.
+/// With a chunk function, hit objects are handed on in chunks and not kept.
+class CSectionStream
+{
+    BeatSetT& mOut;
+    const uint8_t mFlags;
+    const ChunkFunc* mpfChunk;
+    vector<string> mHead;  // property sections and all tags
+    Section_t mOpen{Section_t::_size};  // _size if none or unknown
+    TimingStateT mTiming;
+    EntityT mObj;
+    size_t mCount{};  // of hit objects, handed on ones included
+    float mLast_ms{};  // spawn time of the last hit object
+    bool mHasTiming{};
+    bool mHasTargets{};
+    bool mIsStopped{};
+
+    bool flush()
+    {
+        if (!mpfChunk || mOut.Targets.empty())
+            return true;
+
+        mIsStopped = !(*mpfChunk)(mOut.Targets);
+        mOut.Targets.clear();
+        return !mIsStopped;
+    }
+
+public:
+    CSectionStream(BeatSetT& rOut, uint8_t flags, const ChunkFunc* pfChunk=nullptr) : mOut(rOut), mFlags(flags), mpfChunk(pfChunk) {}
+
+    bool operator()(string_view lne)
+    {
+        string_view tag;
+        if (tryGetTag(lne, tag))
+        {
+            open(tag);
+            mHead.emplace_back(lne);
+            return !mIsStopped;
+        }
+
+        switch (mOpen)
+        {
+        case Section_t::setting:
+        case Section_t::editor:
+        case Section_t::media:
+        case Section_t::complexity:
+            mHead.emplace_back(lne);
+            break;
+
+        case Section_t::timing:
+            if (mFlags & COsuParser::ParseFlagsT::TIMING)
+                assignTimingLine(lne, mTiming, mOut.Events, mOut.Timing);
+            break;
+
+        case Section_t::target:
+            if ((mFlags & COsuParser::ParseFlagsT::TARGETS) && assignTargetLine(lne, mObj))
+            {
+                mOut.Targets.push_back(mObj);
+                mLast_ms = mObj.SpawnTime;
+                if ((++mCount % STREAM_CHUNK_TARGETS) == 0)
+                    return flush();
+            }
+            break;
+
+        default:
+            break;  // events may hold a whole storyboard
+        }
+        return true;
+    }
+
+    // Same results as tryParse on the whole file, false if a chunk function stopped reading
+    bool finish(const string& mapName)
+    {
+        if (!flush())
+            return false;
+
+        bool pass = !mHead.empty();
+        if (pass)
+        {
+            const vector<string_view> lines(mHead.cbegin(), mHead.cend());
+            const StringSequenceT seq{ lines.cbegin(), lines.cend(), lines.size() };
+            pass = assignHeader(seq, mapTags(seq, {}), mapName, mOut);
+        }
+        if (mHasTiming && (mOut.Events.empty() || (mOut.Events.front().Value <= 1) || mOut.Timing.empty()))
+            pass = false;  // missing bpm
+        if (mHasTargets)
+        {
+            pass &= (mCount > 0);
+            xtrace::count("objects parsed", (int64_t)mCount);
+        }
+        if (!mOut.Timing.empty())
+            mOut.Media.AverageRate_bpm = 60000.f / evaluateTiming(mOut.Timing, mLast_ms);
+        return pass;
+    }
+
+private:
+    void open(string_view tag)
+    {
+        mOpen = Section_t::_size;
+        for (size_t i=0; i<size(Tags::All); ++i)
+        {
+            if (Tags::All[i] == tag)
+            {
+                mOpen = static_cast<Section_t>(i);
+                break;
+            }
+        }
+
+        // a repeated tag overrides the former, like in mapTags
+        if ((Section_t::timing == mOpen) && (mFlags & COsuParser::ParseFlagsT::TIMING))
+        {
+            mOut.Events.clear();
+            mOut.Timing.clear();
+            mTiming = {};
+            mHasTiming = true;
+        } else if ((Section_t::target == mOpen) && (mFlags & COsuParser::ParseFlagsT::TARGETS)) {
+            mIsStopped = mpfChunk && mHasTargets;  // handed on chunks can not be taken back
+            mOut.Targets.clear();
+            mObj = {};
+            mCount = 0;
+            mLast_ms = 0.f;
+            mHasTargets = true;
+        }
+    }
+};
+
+}// anonymous namespace
+
+
+string_view COsuParser::stopTag(uint8_t flags) noexcept
+{// sections are in file order
+    if (flags & ParseFlagsT::TARGETS)
+        return {};
+    if (flags & ParseFlagsT::TIMING)
+        return Tags::Osu_Target;
+    return Tags::Osu_Trigger;  // events may hold a whole storyboard
+}
+
+
+bool COsuParser::tryParse(const CBeatmap& rIn, BeatSetT& rOut, uint8_t flags)
+{// rIn must remain unchanged for the duration of the call!
+    if (GameTypes_t::osu != rIn.getGameType() || !rIn.isValid())
+    {// Understands only osu beatmap
+        return false;
+    }
     
+    auto seq = rIn.getSequence();
+    if (seq.isEmpty())
+    {
+        return false;
+    }
+
+    SectionIndex dic;
+    {
+        xtrace::CScope trace("mapTags");
+        dic = mapTags(seq, stopTag(flags));
+    }
+    bool pass = assignHeader(seq, dic, rIn.getFilename(), rOut);
+
+    if (!(flags & (ParseFlagsT::TIMING | ParseFlagsT::TARGETS)))
+        return pass;
+
     // TimingPoints
-    if (0 <= (idxPair = getMappedPair(dic, Tags::Osu_Timing)).first)
+    if (const auto& sec = dic[Section_t::timing]; (flags & ParseFlagsT::TIMING) && sec.isValid())
     {
-        if (assignFromSequence(
-            seq.make_subsequence(idxPair.second, getNextMappedLine(dic, idxPair.first)),
-            rOut.Events))
+        xtrace::CScope trace("assignFromSequence events");
+        if (!assignFromSequence(
+            seq.make_subsequence(sec.First, sec.Last),
+            rOut.Events,
+            rOut.Timing) || rOut.Timing.empty())
         {
-            rOut.Media.AverageRate_bpm = 60000.f / evaluateTiming(rOut.Events);
-        } else {
             pass = false;  // missing bpm
         }
     }// valid pair
 
     // HitObjects
-    if (0 <= (idxPair = getMappedPair(dic, Tags::Osu_Target)).first)
+    if (const auto& sec = dic[Section_t::target]; (flags & ParseFlagsT::TARGETS) && sec.isValid())
     {
+        xtrace::CScope trace("assignFromSequence targets");
         pass &= assignFromSequence(
-            seq.make_subsequence(idxPair.second, getNextMappedLine(dic, idxPair.first)),
+            seq.make_subsequence(sec.First, sec.Last),
             rOut.Targets
         );
+        xtrace::count("objects parsed", (int64_t)rOut.Targets.size());
     }// valid range
+
+    if (!rOut.Timing.empty())
+        rOut.Media.AverageRate_bpm = 60000.f / evaluateTiming(rOut.Timing, rOut.Targets.empty() ? 0.f : rOut.Targets.back().SpawnTime);
     return pass;
 }
 
+
+bool COsuParser::tryParseStream(const string& fullpath, BeatSetT& rOut, uint8_t flags)
+{
+    return tryParseStream(fullpath, rOut, ChunkFunc{}, flags);  // keeps the hit objects
+}
+
+
+bool COsuParser::tryParseStream(const string& fullpath, BeatSetT& rOut, const ChunkFunc& fChunk, uint8_t flags)
+{
+    CBeatmap file;
+    CSectionStream sections(rOut, flags, fChunk ? &fChunk : nullptr);
+    if (!file.initFromStream(fullpath, ref(sections), stopTag(flags)) || (GameTypes_t::osu != file.getGameType()))
+        return false;
+
+    rOut.Game = GameTypes_t::osu;
+    return sections.finish(file.getFilename());
+}
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace NaiSe{
 struct BeatSetT;
+struct EntityT;
 }
 class CBeatmap;
 
@@ -9,7 +16,24 @@ class CBeatmap;
 class COsuParser
 {
 public:
-    static bool tryParse(const CBeatmap& rIn, NaiSe::BeatSetT& rOut);
+    struct ParseFlagsT
+    {
+        static const uint8_t MEDIA = 0x1u;  // general, editor and metadata sections, always parsed
+        static const uint8_t TIMING = 0x2u;  // timing points and average rate
+        static const uint8_t TARGETS = 0x4u;  // hit objects
+        static const uint8_t ALL = 0x7u;
+    };
 
-};
+    // Tag of the first section none of flags needs, empty if the whole file is needed.
+    // Lines from there on can be left out when loading.
+    static std::string_view stopTag(uint8_t flags) noexcept;
+    static bool tryParse(const CBeatmap& rIn, NaiSe::BeatSetT& rOut, uint8_t flags=ParseFlagsT::ALL);
+    // Same as tryParse, but reads the file in chunks without keeping its lines. Only the text is dropped, the parsed
+    // objects are all held in rOut and still grow with the map.
+    static bool tryParseStream(const std::string& fullpath, NaiSe::BeatSetT& rOut, uint8_t flags=ParseFlagsT::ALL);
+    // Hands the hit objects to fChunk in chunks of a few thousand, in file order, and keeps none in rOut. Reading stops
+    // when fChunk returns false or the hit objects section repeats, both return false. Without fChunk same as above.
+    static bool tryParseStream(const std::string& fullpath, NaiSe::BeatSetT& rOut,
+        const std::function<bool(const std::vector<NaiSe::EntityT>&)>& fChunk, uint8_t flags=ParseFlagsT::ALL);
 
+};
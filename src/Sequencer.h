@@ -20,8 +20,10 @@ protected:
 public:
     virtual void transformBeatset(NaiSe::BeatSetT& rInOut) = 0;
     virtual std::vector<std::string> serializeBeatset(const NaiSe::BeatSetT& rIn) const = 0;
+    virtual void serializeBeatset(const NaiSe::BeatSetT& rIn, std::string& rOut) const = 0;  // contiguous, rOut is overwritten
     
     virtual const char* getVersion() const = 0;
     void setMode(modeFlag_t flags) { mEnabledModes = flags; }  // TODO Implement handling
+    modeFlag_t getMode() const { return mEnabledModes; }
 };
 
@@ -0,0 +1,156 @@
+#include "BeatmapGenerator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>  // mt19937
+#include <sstream>
+
+
+using namespace std;
+using namespace NaiSe;
+
+
+namespace {
+
+const uint32_t START_MS = 4000;  // first object after lead-in
+const float BASE_BEAT_MS = 500.f;  // 120bpm
+const char EOL[] = "\r\n";
+
+/// mt19937 output is fixed by the standard, the distributions are not. Keep mapping own.
+class CRandom
+{
+    mt19937 mEngine;
+
+public:
+    explicit CRandom(uint32_t seed) : mEngine(seed) {}
+
+    float unit() { return (mEngine() >> 8) * (1.f / 16777216.f); }  // [0, 1)
+    uint32_t below(uint32_t n) { return n ? (uint32_t)(unit() * n) : 0; }
+    bool chance(float share) { return unit() < share; }
+};
+
+void appendHeader(ostringstream& rOut, const GeneratorSettingT& setting)
+{
+    rOut << "osu file format v14" << EOL << EOL
+        << "[General]" << EOL
+        << "AudioFilename: audio.mp3" << EOL
+        << "AudioLeadIn: 0" << EOL
+        << "PreviewTime: " << START_MS << EOL
+        << "Countdown: 0" << EOL
+        << "Mode: " << enum_cast(setting.Mode) << EOL << EOL
+        << "[Editor]" << EOL
+        << "// generated, seed " << setting.Seed << EOL
+        << "GridSize: 8" << EOL << EOL
+        << "[Metadata]" << EOL
+        << "Title:Generated " << setting.ObjectCount << EOL
+        << "Artist:NaiSeBeat" << EOL
+        << "Creator:Benchmark" << EOL
+        << "Version:Seed" << setting.Seed << EOL << EOL
+        << "[Difficulty]" << EOL
+        << "HPDrainRate:5" << EOL
+        << "CircleSize:4" << EOL
+        << "OverallDifficulty:7" << EOL << EOL
+        << "[Events]" << EOL
+        << "//Background and Video events" << EOL
+        << "0,0,\"bg.jpg\",0,0" << EOL << EOL;
+}
+
+// First point defines the beat, then beat length changes and inherited kiai toggles alternate
+void appendTiming(ostringstream& rOut, const GeneratorSettingT& setting, uint32_t tEnd, CRandom& rnd)
+{
+    rOut << "[TimingPoints]" << EOL;
+    const uint32_t cnt = max(1u, setting.TimingCount);
+    const uint32_t step = max(1u, tEnd / cnt);
+    bool kiai = false;
+    for (uint32_t i=0; i<cnt; ++i)
+    {
+        const uint32_t ts = 1000 + i * step;
+        if (!i || (i & 1))
+        {
+            const float beat = i ? BASE_BEAT_MS * (0.75f + 0.5f * rnd.unit()) : BASE_BEAT_MS;
+            rOut << ts << ',' << beat << ",4,2,1,60,1,0" << EOL;
+        } else {
+            kiai = !kiai;
+            rOut << ts << ",-" << (50 + rnd.below(4) * 25) << ",4,2,1,60,0," << (kiai ? 1 : 0) << EOL;
+        }
+    }
+    rOut << EOL;
+}
+
+void appendObjects(ostringstream& rOut, const GeneratorSettingT& setting, CRandom& rnd)
+{
+    const bool isMania = GameMode_t::os_mania == setting.Mode;
+    const float period = 1000.f / max(0.1f, setting.Density_hz);
+    const uint8_t taikoSounds[] = { 0, 2, 4, 6, 8, 12 };
+    float ts = START_MS;
+    float freeAt[4] = {};  // mania columns
+    uint32_t type;
+
+    rOut << "[HitObjects]" << EOL;
+    for (uint32_t i=0; i<setting.ObjectCount; ++i)
+    {
+        type = (0 == rnd.below(8)) ? 4 : 0;  // new combo
+        if (isMania)
+        {// one object per column at a time, holds block their column until released
+            uint32_t col = rnd.below(4);
+            for (uint32_t n=0; (n < 4) && (ts < freeAt[col]); ++n)
+            {
+                col = (col + 1) & 3;
+            }
+            if (ts >= freeAt[col])
+            {
+                const uint32_t x = col * (Os_Map_Width / 4) + 64;
+                if (rnd.chance(setting.HoldShare))
+                {
+                    const auto tEnd = (uint32_t)(ts + period * (1 + rnd.below(4)));
+                    rOut << x << ",192," << (uint32_t)ts << ',' << (128 | type) << ",0," << tEnd << ":0:0:0:0:" << EOL;
+                    freeAt[col] = tEnd + 1.f;
+                } else {
+                    rOut << x << ",192," << (uint32_t)ts << ',' << (1 | type) << ",0,0:0:0:0:" << EOL;
+                    freeAt[col] = ts + 1.f;
+                }
+                if (rnd.chance(0.2f))
+                    continue;  // chord, same timestamp
+            }
+        } else {
+            const float roll = rnd.unit();
+            if (roll < setting.SpinShare)
+            {
+                const uint32_t tEnd = (uint32_t)(ts + period * (4 + rnd.below(8)));
+                rOut << "256,192," << (uint32_t)ts << ',' << (8 | 4) << ",0," << tEnd << ",0:0:0:0:" << EOL;
+                ts = (float)tEnd;
+            } else if (roll < setting.SpinShare + setting.HoldShare) {
+                rOut << "256,192," << (uint32_t)ts << ',' << (2 | type) << ",0,L|356:192," << (1 + rnd.below(2)) << ',' << (70 + rnd.below(3) * 70) << EOL;
+            } else {
+                rOut << "256,192," << (uint32_t)ts << ',' << (1 | type) << ',' << (int)taikoSounds[rnd.below(sizeof(taikoSounds))] << ",0:0:0:0:" << EOL;
+            }
+        }
+        ts += period * (0.5f + rnd.below(4) * 0.5f);  // average matches density
+    }
+}
+
+}// anonymous ns
+
+
+string CBeatmapGenerator::generate(const GeneratorSettingT& setting)
+{
+    CRandom rnd(setting.Seed);
+    ostringstream ss;
+    const auto tEnd = (uint32_t)(START_MS + setting.ObjectCount * 1000.f / max(0.1f, setting.Density_hz));
+
+    appendHeader(ss, setting);
+    appendTiming(ss, setting, tEnd, rnd);
+    appendObjects(ss, setting, rnd);
+    return ss.str();
+}
+
+
+bool CBeatmapGenerator::writeFile(const string& fullpath, const GeneratorSettingT& setting)
+{
+    ofstream fs(fullpath, ios::binary);  // keep CRLF as is
+    if (!fs.is_open())
+        return false;
+
+    fs << generate(setting);
+    return fs.good();
+}
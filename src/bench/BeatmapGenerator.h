@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "common.hpp"
+
+
+/// Settings of a synthetic osu! beatmap. Equal settings give equal files on every platform.
+struct GeneratorSettingT
+{
+    NaiSe::GameMode_t Mode{NaiSe::GameMode_t::os_mania};  // os_mania or os_taiko
+    uint32_t ObjectCount{2000};
+    float    Density_hz{6.f};  // average objects per second
+    float    HoldShare{0.1f};  // hold notes in mania, sliders in taiko
+    float    SpinShare{0.02f};  // spinners, taiko only
+    uint32_t TimingCount{4};  // timing points, alternating beat length and kiai changes
+    uint32_t Seed{1};
+};
+
+
+class CBeatmapGenerator
+{
+public:
+    // Text of a complete .osu file, lines end with CRLF like the editor writes them
+    static std::string generate(const GeneratorSettingT& setting);
+    static bool writeFile(const std::string& fullpath, const GeneratorSettingT& setting);
+};
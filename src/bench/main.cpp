@@ -0,0 +1,307 @@
+#include <algorithm>  // sort
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <iostream>
+#include <numeric>  // accumulate
+#include <string>
+#include <vector>
+
+#include "BeatmapGenerator.h"
+#include "Beatmap.h"
+#include "BsSequencer.h"
+#include "Daemon.h"
+#include "OsuParser.h"
+#include "util/Options.hpp"
+#include "util/xmemory.hpp"
+
+
+enum class argOpts_t : int
+{
+    OPT_HELP, OPT_MODE, OPT_COUNT, OPT_DENSITY, OPT_HOLDS, OPT_SPINS, OPT_TIMING, OPT_ITER, OPT_SEED, OPT_GEN, OPT_SOCKET, OPT_DEPTH,
+    OPT_UNKNOWN, OPT_NOOPT, OPT_DASH, OPT_LDASH, OPT_DONE
+};
+
+static const char* const USAGE = "[-m mania|taiko] [-c count] [-d density] [-l share] [-p share] [-t count] [-i iterations] [-s seed] [-g path] [-u path [-q depth]]\nConverts a generated beatmap repeatedly and reports the time spent per stage";
+static const nih::Parameter<argOpts_t> PARAM_DEF[]
+{
+    { argOpts_t::OPT_HELP,    '?', "help",       "", "Show command hints." },
+    { argOpts_t::OPT_MODE,    'm', "mode",       "mania|taiko", "Game mode of the generated beatmap, default mania." },
+    { argOpts_t::OPT_COUNT,   'c', "count",      "count", "Number of hit objects, default 2000." },
+    { argOpts_t::OPT_DENSITY, 'd', "density",    "hz", "Average hit objects per second, default 6." },
+    { argOpts_t::OPT_HOLDS,   'l', "long",       "share", "Share of hold notes (mania) or sliders (taiko) from 0 to 1, default 0.1." },
+    { argOpts_t::OPT_SPINS,   'p', "spin",       "share", "Share of spinners from 0 to 1, taiko only, default 0.02." },
+    { argOpts_t::OPT_TIMING,  't', "timing",     "count", "Number of timing points, default 4." },
+    { argOpts_t::OPT_ITER,    'i', "iterations", "count", "Conversion runs to measure, default 20." },
+    { argOpts_t::OPT_SEED,    's', "seed",       "seed", "Seed of the generator, default 1." },
+    { argOpts_t::OPT_GEN,     'g', "generate",   "path", "Only write the generated beatmap to 'path'." },
+    { argOpts_t::OPT_SOCKET,  'u', "unix",       "path", "Send the iterations to a daemon listening on socket 'path' and report throughput and latency." },
+    { argOpts_t::OPT_DEPTH,   'q', "queue",      "depth", "Requests in flight on the daemon connection, default 8." }
+};
+
+
+namespace {
+
+using NaiSe::enum_cast;
+using BenchClock = std::chrono::steady_clock;
+
+enum class Stage_t : size_t { load, parse, transform, serialize, write, _size };
+const char* const STAGE_NAMES[] = { "initFromPath", "tryParse", "transformBeatset", "serializeBeatset", "writeMap" };
+
+/// Collected durations of one stage.
+struct SamplesT
+{
+    std::vector<double> Time_ms;
+
+    void add(BenchClock::time_point start, BenchClock::time_point stop)
+    {
+        Time_ms.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+};
+
+// Sorts the samples, an even count averages the middle two
+double medianOf(SamplesT& rSamples)
+{
+    auto& t = rSamples.Time_ms;
+    if (t.empty())
+        return 0.0;
+
+    std::sort(t.begin(), t.end());
+    return (t.size() & 1) ? t[t.size() / 2] : 0.5 * (t[t.size() / 2 - 1] + t[t.size() / 2]);
+}
+
+void report(const char* name, SamplesT& rSamples, size_t targets, size_t bytes)
+{
+    const auto& t = rSamples.Time_ms;
+    if (t.empty())
+        return;
+
+    const double median = medianOf(rSamples);
+    const double mean = std::accumulate(t.cbegin(), t.cend(), 0.0) / t.size();
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << t.front()
+        << std::setw(10) << median
+        << std::setw(10) << mean
+        << std::setw(12) << std::setprecision(1) << (median > 0 ? targets / median : 0.0)
+        << std::setw(10);
+    if (bytes && (median > 0))
+        std::cout << bytes / (median * 1000.0) << std::endl;
+    else
+        std::cout << '-' << std::endl;  // stage works on memory only
+}
+
+// Whole pipeline once per iteration, each stage timed on its own
+bool run(const std::string& path, const std::string& outName, int iterations, SamplesT (&rSamples)[enum_cast(Stage_t::_size)], size_t& rOutTargets)
+{
+    CBsSequencer seq;
+    std::string buff;
+    for (int i=0; i<iterations; ++i)
+    {
+        xmemory::CScratchScope scratch;  // like one conversion of the translator
+        CBeatmap file;
+        NaiSe::BeatSetT data;
+
+        auto t0 = BenchClock::now();
+        if (!file.initFromPath(path, true))
+            return false;
+        auto t1 = BenchClock::now();
+        if (!COsuParser::tryParse(file, data))
+            return false;
+        rOutTargets = data.Targets.size();
+        auto t2 = BenchClock::now();
+        seq.transformBeatset(data);
+        auto t3 = BenchClock::now();
+        seq.serializeBeatset(data, buff);
+        auto t4 = BenchClock::now();
+        CBeatmap::writeMap(outName, data.Game, buff);
+        auto t5 = BenchClock::now();
+
+        rSamples[enum_cast(Stage_t::load)].add(t0, t1);
+        rSamples[enum_cast(Stage_t::parse)].add(t1, t2);
+        rSamples[enum_cast(Stage_t::transform)].add(t2, t3);
+        rSamples[enum_cast(Stage_t::serialize)].add(t3, t4);
+        rSamples[enum_cast(Stage_t::write)].add(t4, t5);
+    }
+    return true;
+}
+
+// Keeps 'depth' requests of the same map in flight, latency counts from sending to a complete answer
+bool runDaemon(const std::string& socketPath, const std::string& content, int iterations, int depth, SamplesT& rSamples, double& rOutTotal_ms)
+{
+    CDaemonClient client;
+    if (!client.connect(socketPath))
+        return false;
+
+    std::vector<BenchClock::time_point> sent(iterations);
+    std::string name, map, info;
+    uint32_t id{};
+    bool isOk{};
+    int next{};
+    const auto start = BenchClock::now();
+    for (int done=0; done<iterations; ++done)
+    {
+        for (; (next < iterations) && (next - done < depth); ++next)
+        {
+            sent[next] = BenchClock::now();
+            if (!client.send((uint32_t)next, 2u, content))
+                return false;
+        }
+        if (!client.receive(id, isOk, name, map, info) || !isOk || (id >= (uint32_t)iterations))
+            return false;
+        rSamples.add(sent[id], BenchClock::now());
+    }
+    rOutTotal_ms = std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+    return true;
+}
+
+}// anonymous ns
+
+
+int main(int argc, char** argv)
+{
+    namespace fs = std::filesystem;
+
+    argOpts_t opt;
+    GeneratorSettingT setting;
+    int iterations = 20;
+    int depth = 8;
+    std::string genPath;
+    std::string socketPath;
+
+    auto fArgs = nih::make_Options(argc, argv, USAGE, PARAM_DEF);
+    do
+    {
+        opt = fArgs();
+        try
+        {
+            switch (opt)
+            {
+            case argOpts_t::OPT_HELP:
+                std::cout << fArgs.usage();
+                return 0;
+
+            case argOpts_t::OPT_MODE:
+                if (std::string("taiko") == fArgs[1])
+                    setting.Mode = NaiSe::GameMode_t::os_taiko;
+                else if (std::string("mania") == fArgs[1])
+                    setting.Mode = NaiSe::GameMode_t::os_mania;
+                else
+                    std::cerr << fArgs[1] << " is not a supported mode and has been ignored." << std::endl;
+                break;
+
+            case argOpts_t::OPT_COUNT:
+                setting.ObjectCount = (uint32_t)std::max(0, std::stoi(fArgs[1]));
+                break;
+
+            case argOpts_t::OPT_DENSITY:
+                setting.Density_hz = std::max(0.1f, std::stof(fArgs[1]));
+                break;
+
+            case argOpts_t::OPT_HOLDS:
+                setting.HoldShare = std::clamp(std::stof(fArgs[1]), 0.f, 1.f);
+                break;
+
+            case argOpts_t::OPT_SPINS:
+                setting.SpinShare = std::clamp(std::stof(fArgs[1]), 0.f, 1.f);
+                break;
+
+            case argOpts_t::OPT_TIMING:
+                setting.TimingCount = (uint32_t)std::max(1, std::stoi(fArgs[1]));
+                break;
+
+            case argOpts_t::OPT_ITER:
+                iterations = std::max(1, std::stoi(fArgs[1]));
+                break;
+
+            case argOpts_t::OPT_SEED:
+                setting.Seed = (uint32_t)std::stoul(fArgs[1]);
+                break;
+
+            case argOpts_t::OPT_GEN:
+                genPath = fArgs[1];
+                break;
+
+            case argOpts_t::OPT_SOCKET:
+                socketPath = fArgs[1];
+                break;
+
+            case argOpts_t::OPT_DEPTH:
+                depth = std::max(1, std::stoi(fArgs[1]));
+                break;
+
+            case argOpts_t::OPT_DONE:
+                break;
+
+            default:
+                std::cerr << "Arguments passed in wrong format. For help, press '?' or \"help\"" << std::endl;
+                std::cerr << fArgs.show(0);
+                return (int)opt;
+            }
+        } catch (const std::exception&) {
+            std::cerr << fArgs[1] << " is not a number and has been ignored." << std::endl;
+        }
+    } while (argOpts_t::OPT_DONE != opt);
+
+    if (!genPath.empty())
+        return CBeatmapGenerator::writeFile(genPath, setting) ? 0 : 1;
+
+    std::error_code ec;
+    auto dir = fs::temp_directory_path(ec) / "naise_bench";
+    fs::create_directories(dir, ec);
+    const auto input = (dir / "generated.osu").string();
+    if (!CBeatmapGenerator::writeFile(input, setting))
+    {
+        std::cerr << "Could not write " << input << std::endl;
+        return 1;
+    }
+
+    if (!socketPath.empty())
+    {
+        std::ifstream fsIn(input, std::ios::binary);
+        const std::string content{ std::istreambuf_iterator<char>(fsIn), std::istreambuf_iterator<char>() };
+        SamplesT latency;
+        double total_ms{};
+        if (!runDaemon(socketPath, content, iterations, depth, latency, total_ms))
+        {
+            std::cerr << "No conversion served by " << socketPath << std::endl;
+            return 1;
+        }
+
+        auto& t = latency.Time_ms;
+        std::sort(t.begin(), t.end());
+        const auto fAt = [&t](double q) { return t[std::min(t.size() - 1, (size_t)(q * t.size()))]; };
+        std::cout << iterations << " requests of " << content.size() << " bytes, " << depth << " in flight" << std::endl;
+        std::cout << std::fixed << std::setprecision(1) << (iterations * 1000.0 / total_ms) << " conversions/s, latency ms"
+            << std::setprecision(3) << " p50 " << fAt(0.5) << " p99 " << fAt(0.99) << " max " << t.back() << std::endl;
+        return 0;
+    }
+
+    SamplesT samples[enum_cast(Stage_t::_size)];
+    size_t targets{};
+    if (!run(input, (dir / "generated").string(), iterations, samples, targets))
+    {
+        std::cerr << "Conversion of " << input << " failed." << std::endl;
+        return 1;
+    }
+
+    const auto inBytes = (size_t)fs::file_size(input, ec);
+    const auto outBytes = (size_t)fs::file_size(dir / "generated.dat", ec);
+    std::cout << (NaiSe::GameMode_t::os_taiko == setting.Mode ? "taiko" : "mania")
+        << ", " << targets << " targets, "
+        << inBytes << " bytes in, " << outBytes << " bytes out, " << iterations << " iterations" << std::endl;
+    std::cout << std::left << std::setw(18) << "stage" << std::right
+        << std::setw(10) << "min ms" << std::setw(10) << "med ms" << std::setw(10) << "mean ms"
+        << std::setw(12) << "targets/ms" << std::setw(10) << "MB/s" << std::endl;
+
+    const size_t stageBytes[] = { inBytes, inBytes, 0, outBytes, outBytes };
+    double total{};
+    for (size_t s=0; s<enum_cast(Stage_t::_size); ++s)
+    {
+        report(STAGE_NAMES[s], samples[s], targets, stageBytes[s]);
+        total += medianOf(samples[s]);
+    }
+    std::cout << std::left << std::setw(18) << "total (median)" << std::right << std::setw(20) << std::setprecision(3) << total << std::endl;
+    return 0;
+}
@@ -7,7 +7,10 @@
 #include <cassert>
 #include <exception>
 #include <type_traits>  // underlying_type
+#include <array>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -89,8 +92,8 @@ union HitTypeT
 
 struct StringSequenceT
 {
-    std::vector<std::string>::const_iterator Begin;
-    std::vector<std::string>::const_iterator End;  // points behind last element
+    std::vector<std::string_view>::const_iterator Begin;
+    std::vector<std::string_view>::const_iterator End;  // points behind last element
     size_t Distance{};  // from fist to last inclusive, same as count or size
 
     StringSequenceT() = delete;
@@ -128,12 +131,22 @@ struct StringSequenceT
     }
 };
 
+/// Integer time. Parsed timestamps are whole milliseconds, sequenced ones are subgrid steps of a beat.
+using tick_t = int32_t;
+
+// Steps per beat of a subgrid size. Grids finer than 1/8 snap to 1/8, others to the next coarser power of two.
+constexpr uint8_t ticksPerBeat(int subgridSize) noexcept
+{
+    return (8 <= subgridSize) ? 8 : (4 <= subgridSize) ? 4 : (2 <= subgridSize) ? 2 : 1;
+}
+
 struct SettingT
 {
     std::string  MapName;
     uint16_t     LeadIn_ms{};  // unrelated to timestamps
     GameMode_t   Mode{GameMode_t::undefined};
-    uint8_t      SubgridSize{8};
+    uint8_t      SubgridSize{8};  // ticks per beat
+    float        Rating{};  // overall difficulty, 0 to 10
 };
 
 struct MediaInfoT
@@ -153,6 +166,13 @@ struct EventT
     float Value{};
 };
 
+/// Beat grid from an uninherited timing point on, until the next one.
+struct TimingT
+{
+    float Start_ms{};
+    float Period_ms{};  // of one beat
+};
+
 struct EntityT
 {
     std::pair<uint16_t, uint16_t> Location;
@@ -161,6 +181,71 @@ struct EntityT
     float       Value{};
 };
 
+/// Entities stored column by column, for passes that read only one or two fields.
+/// Filled entity by entity and appended to the row layout of BeatSetT. Columns are scratch data and may use an arena.
+struct EntityColumnsT
+{
+    std::pmr::vector<float>    SpawnTime;
+    std::pmr::vector<uint16_t> Lane;  // Location.first
+    std::pmr::vector<uint16_t> Layer;  // Location.second
+    std::pmr::vector<uint8_t>  Type;  // EntityTypeT::RawType
+    std::pmr::vector<float>    Value;
+
+    EntityColumnsT() = default;
+    explicit EntityColumnsT(std::pmr::memory_resource* pRes) :
+        SpawnTime(pRes), Lane(pRes), Layer(pRes), Type(pRes), Value(pRes) {}
+
+    size_t size() const { return SpawnTime.size(); }
+    bool empty() const { return SpawnTime.empty(); }
+
+    void clear()
+    {
+        SpawnTime.clear();
+        Lane.clear();
+        Layer.clear();
+        Type.clear();
+        Value.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        SpawnTime.reserve(n);
+        Lane.reserve(n);
+        Layer.reserve(n);
+        Type.reserve(n);
+        Value.reserve(n);
+    }
+
+    void push_back(const EntityT& en)
+    {
+        SpawnTime.push_back(en.SpawnTime);
+        Lane.push_back(en.Location.first);
+        Layer.push_back(en.Location.second);
+        Type.push_back(en.Type.RawType);
+        Value.push_back(en.Value);
+    }
+
+    EntityT operator[](size_t i) const
+    {
+        EntityT en;
+        en.Location = { Lane[i], Layer[i] };
+        en.Type.RawType = Type[i];
+        en.SpawnTime = SpawnTime[i];
+        en.Value = Value[i];
+        return en;
+    }
+
+    void appendTo(std::vector<EntityT>& rOut) const
+    {
+        rOut.reserve(rOut.size() + size());
+        for (size_t i=0; i<size(); ++i)
+        {
+            rOut.push_back((*this)[i]);
+        }
+    }
+};
+
+/// Move-only, copies of whole beatmaps are never needed.
 struct BeatSetT
 {
     GameTypes_t  Game{GameTypes_t::unknown};
@@ -168,8 +253,15 @@ struct BeatSetT
     SettingT     Setting;
     uint8_t      StageLevel{};
     std::vector<EventT> Events;
+    std::vector<TimingT> Timing;  // sorted by start
     std::vector<EntityT> Targets;
     std::vector<EntityT> Objects;
+
+    BeatSetT() = default;
+    BeatSetT(const BeatSetT&) = delete;
+    BeatSetT& operator=(const BeatSetT&) = delete;
+    BeatSetT(BeatSetT&&) = default;
+    BeatSetT& operator=(BeatSetT&&) = default;
 };
 
 template <typename TEnum, class... TArgs>
@@ -191,8 +283,25 @@ public:
     using std::vector<TArgs...>::operator [];
 };
 
+template <typename TEnum, class T, size_t N = static_cast<size_t>(TEnum::_size)>
+class xarr : public std::array<T, N>
+{
+public:
+    decltype(auto) operator[](TEnum const i)
+    {
+        return (*this)[static_cast<size_t>(i)];
+    }
+
+    const auto& operator[](TEnum const i) const
+    {
+        return (*this)[static_cast<size_t>(i)];
+    }
+
+    using std::array<T, N>::operator [];
+};
+
 template<typename TEnum>
-auto enum_cast(const TEnum& e) { return static_cast<typename std::underlying_type<TEnum>::type>(e); }
+constexpr auto enum_cast(const TEnum& e) { return static_cast<typename std::underlying_type<TEnum>::type>(e); }
 
 }//namespace NaiSe
 
@@ -1,16 +1,21 @@
+#include <algorithm>  // max
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <NaiveSequencer.h>
+#include "Daemon.h"
 #include "util/Options.hpp"
+#include "util/xtrace.hpp"
 
 
 enum class argOpts_t : int
 {
-    OPT_HELP, OPT_FILE_EZ, OPT_FILE_NM, OPT_FILE_HD, OPT_FILE_EX, OPT_FILE_SP, OPT_FILE_XX,
+    OPT_HELP, OPT_FILE_EZ, OPT_FILE_NM, OPT_FILE_HD, OPT_FILE_EX, OPT_FILE_SP, OPT_FILE_XX, OPT_ARCHIVE, OPT_TREE, OPT_WATCH, OPT_LISTEN, OPT_JOBS, OPT_CACHE, OPT_TRACE,
     OPT_UNKNOWN, OPT_NOOPT, OPT_DASH, OPT_LDASH, OPT_DONE
 };
 
-static const char* const USAGE = "[-e|n|h|x|s|r<0-4> path ] [...]\nProviding no options will create a loose map";
+static const char* const USAGE = "[-t path] [-j count] [-c path] [-e|n|h|x|s|r<0-4> path ] [-z path] [-d path] [-w path] [-l path] [...]\nProviding no options will create a loose map";
 static const nih::Parameter<argOpts_t> PARAM_DEF[]
 {
     { argOpts_t::OPT_HELP,    '?', "help",    "", "Show command hints." },
@@ -19,15 +24,37 @@ static const nih::Parameter<argOpts_t> PARAM_DEF[]
     { argOpts_t::OPT_FILE_HD, 'h', "hard",    "path", "Convert single beatmap and store as hard difficulty." },
     { argOpts_t::OPT_FILE_EX, 'x', "extra",   "path", "Convert single beatmap and store as extra hard difficulty." },
     { argOpts_t::OPT_FILE_SP, 's', "special", "path", "Convert single beatmap and store as special difficulty." },
-    { argOpts_t::OPT_FILE_XX, 'r', "rank",    "level,path", "Convert beatmap as part of a beatset and store as rank 'level' difficulty.\nNote: Will create a new index file\nExample: -r1 demoA.osu -r3 demoB.osu" }
+    { argOpts_t::OPT_FILE_XX, 'r', "rank",    "level,path", "Convert beatmap as part of a beatset and store as rank 'level' difficulty.\nNote: Will create a new index file\nExample: -r1 demoA.osu -r3 demoB.osu" },
+    { argOpts_t::OPT_ARCHIVE, 'z', "archive", "path", "Convert all beatmaps of an .osz archive as one beatset, without unpacking.\nRanks follow the number of hit objects." },
+    { argOpts_t::OPT_TREE,    'd', "directory", "path", "Convert all beatmaps below folder 'path', or those matching a file pattern like maps/*.osu below its folder.\nMaps of equal artist, title and creator form one beatset, ranked by overall difficulty." },
+    { argOpts_t::OPT_WATCH,   'w', "watch",   "path", "Convert the beatsets below folder 'path' like -d, then keep converting beatmaps written there\nuntil stopped. Only the changed map and the index of its set are rewritten." },
+    { argOpts_t::OPT_LISTEN,  'l', "listen",  "path", "Serve conversions of .osu content sent to the Unix domain socket 'path' until stopped,\nanswering with the map and index JSON. Runs on 'count' threads of -j." },
+    { argOpts_t::OPT_JOBS,    'j', "jobs",    "count", "Convert single beatmaps, the difficulties of a beatset, or the beatsets of a directory, concurrently on 'count' threads,\n0 uses all cores. Writes one index file per output folder. Difficulties of a beatset use all cores without it." },
+    { argOpts_t::OPT_CACHE,   'c', "cache",   "path", "Skip single beatmaps converted before with equal content and stage.\nRecords are kept in the file at 'path'." },
+    { argOpts_t::OPT_TRACE,   't', "trace",   "path", "Record stage timings and counters to 'path' in Chrome trace format, wherever the option is given." }
 };
 
 
 int main(int argc, char** argv)
 {
     int iarg{};
+    bool isAppended{};
+    int jobs = -1;  // sequential without index files
     argOpts_t opt;
     NaiSe::CBeatTranslator bt;
+    std::vector<std::pair<std::string, uint8_t>> singles;
+    std::vector<std::string> trees;
+    std::string watchDir;
+    std::string socketPath;
+    std::string tracePath;
+
+    // Options act in order, but maps loaded by those before -t are to be recorded as well
+    auto fScan = nih::make_Options(argc, argv, USAGE, PARAM_DEF);
+    while ((opt = fScan()) < argOpts_t::OPT_UNKNOWN || (argOpts_t::OPT_NOOPT == opt))
+    {
+        if (argOpts_t::OPT_TRACE == opt)
+            xtrace::CTracer::instance().enable();
+    }
 
     auto fArgs = nih::make_Options(argc, argv, USAGE, PARAM_DEF);
     do
@@ -40,27 +67,27 @@ int main(int argc, char** argv)
 
         //--> without file index
         case argOpts_t::OPT_NOOPT:
-            bt.convertFile(fArgs[1]);
+            singles.emplace_back(fArgs[0], 0u);  // the argument itself
             break;
 
         case argOpts_t::OPT_FILE_EZ:
-            bt.convertFile(fArgs[1], 1u);
+            singles.emplace_back(fArgs[1], 1u);
             break;
 
         case argOpts_t::OPT_FILE_NM:
-            bt.convertFile(fArgs[1], 3u);
+            singles.emplace_back(fArgs[1], 3u);
             break;
 
         case argOpts_t::OPT_FILE_HD:
-            bt.convertFile(fArgs[1], 5u);
+            singles.emplace_back(fArgs[1], 5u);
             break;
 
         case argOpts_t::OPT_FILE_EX:
-            bt.convertFile(fArgs[1], 7u);
+            singles.emplace_back(fArgs[1], 7u);
             break;
 
         case argOpts_t::OPT_FILE_SP:
-            bt.convertFile(fArgs[1], 9u);
+            singles.emplace_back(fArgs[1], 9u);
             break;
         //<-- without file index
 
@@ -74,33 +101,105 @@ int main(int argc, char** argv)
             switch (iarg)
             {
             case 0:
-                bt.appendFile(fArgs[2], NaiSe::Difficulty_t::easy);
+                isAppended = bt.appendFile(fArgs[2], NaiSe::Difficulty_t::easy);
                 break;
 
             case 1:
-                bt.appendFile(fArgs[2], NaiSe::Difficulty_t::normal);
+                isAppended = bt.appendFile(fArgs[2], NaiSe::Difficulty_t::normal);
                 break;
 
             case 2:
-                bt.appendFile(fArgs[2], NaiSe::Difficulty_t::hard);
+                isAppended = bt.appendFile(fArgs[2], NaiSe::Difficulty_t::hard);
                 break;
 
             case 3:
-                bt.appendFile(fArgs[2], NaiSe::Difficulty_t::extra);
+                isAppended = bt.appendFile(fArgs[2], NaiSe::Difficulty_t::extra);
                 break;
 
             case 4:
-                bt.appendFile(fArgs[2], NaiSe::Difficulty_t::special);
+                isAppended = bt.appendFile(fArgs[2], NaiSe::Difficulty_t::special);
                 break;
 
             default:
                 std::cerr << fArgs[1] << " does not refer to a known difficulty and has been ignored." << std::endl;
+                isAppended = true;  // reported
                 break;
             }
+            if (!isAppended)
+                std::cerr << fArgs[2] << " can not be read, or its rank is taken, and has been ignored." << std::endl;
+            break;
+
+        case argOpts_t::OPT_ARCHIVE:
+            if (!bt.appendArchive(fArgs[1]))
+                std::cerr << fArgs[1] << " holds no readable beatmap and has been ignored." << std::endl;
+            break;
+
+        case argOpts_t::OPT_TREE:
+            trees.emplace_back(fArgs[1]);
+            break;
+
+        case argOpts_t::OPT_WATCH:
+            watchDir = fArgs[1];
+            break;
+
+        case argOpts_t::OPT_LISTEN:
+            socketPath = fArgs[1];
+            break;
+
+        case argOpts_t::OPT_JOBS:
+            try
+            {
+                jobs = std::max(0, std::stoi(fArgs[1]));
+            } catch (const std::exception&) {
+                std::cerr << fArgs[1] << " is not a thread count and has been ignored." << std::endl;
+            }
+            break;
+
+        case argOpts_t::OPT_CACHE:
+            if (!bt.setCache(fArgs[1]))
+                std::cerr << fArgs[1] << " holds no conversion records, starting a new cache." << std::endl;
+            break;
+
+        case argOpts_t::OPT_TRACE:
+            tracePath = fArgs[1];  // enabled by the scan
             break;
 
         case argOpts_t::OPT_DONE:
-            bt.translate();  // no effect if nothing in queue or already consumed
+            if (jobs < 0)
+            {
+                for (auto&& file : singles)
+                {
+                    bt.convertFile(file.first.c_str(), file.second);
+                }
+            } else if (!singles.empty()) {
+                auto cnt = bt.convertBatch(singles, (unsigned)jobs);
+                if (cnt < singles.size())
+                    std::cerr << (singles.size() - cnt) << " of " << singles.size() << " beatmaps could not be converted." << std::endl;
+            }
+            bt.translate((jobs < 0) ? 0u : (unsigned)jobs);  // no effect if nothing in queue or already consumed
+            for (auto&& tree : trees)
+            {
+                if (!bt.convertTree(tree.c_str(), (jobs < 0) ? 1u : (unsigned)jobs))
+                    std::cerr << tree << " holds no convertible beatmap." << std::endl;
+            }
+            if (!socketPath.empty())
+            {
+                if (!tracePath.empty())
+                    xtrace::CTracer::instance().save(tracePath);  // serving does not end by itself
+                std::cout << "Listening on " << socketPath << ", stop with Ctrl+C." << std::endl;
+                if (!CConversionDaemon(bt, (jobs < 0) ? 0u : (unsigned)jobs).run(socketPath))
+                    std::cerr << socketPath << " can not be listened on." << std::endl;
+            }
+            if (!watchDir.empty())
+            {
+                if (!tracePath.empty())
+                    xtrace::CTracer::instance().save(tracePath);  // watching does not end by itself
+                std::cout << "Watching " << watchDir << ", stop with Ctrl+C." << std::endl;
+                if (!bt.watchTree(watchDir.c_str()))
+                    std::cerr << watchDir << " can not be watched." << std::endl;
+            }
+            if (!tracePath.empty() && !xtrace::CTracer::instance().save(tracePath))
+                std::cerr << "Could not write trace to " << tracePath << std::endl;
             break;
 
         default:
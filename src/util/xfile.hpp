@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>  // exchange
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace xfile {
+
+/// Read-only mapping of a whole file. Move-only, unmapped on destruction.
+class CMappedFile
+{
+    const char* mpData{};
+    size_t      mSize{};
+#ifdef _WIN32
+    HANDLE      mFile{INVALID_HANDLE_VALUE};
+    HANDLE      mMapping{};
+#endif
+
+public:
+    CMappedFile() = default;
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    CMappedFile(CMappedFile&& other) noexcept { *this = std::move(other); }
+
+    CMappedFile& operator=(CMappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            mpData = std::exchange(other.mpData, nullptr);
+            mSize = std::exchange(other.mSize, 0);
+#ifdef _WIN32
+            mFile = std::exchange(other.mFile, INVALID_HANDLE_VALUE);
+            mMapping = std::exchange(other.mMapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    ~CMappedFile() { close(); }
+
+    bool isOpen() const { return nullptr != mpData; }
+    std::string_view view() const { return {mpData, mSize}; }
+
+    // Empty files can not be mapped and are reported as failure.
+    bool open(const std::string& fullpath)
+    {
+        close();
+#ifdef _WIN32
+        mFile = CreateFileA(fullpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (INVALID_HANDLE_VALUE == mFile)
+            return false;
+
+        LARGE_INTEGER sz{};
+        if (!GetFileSizeEx(mFile, &sz) || (0 == sz.QuadPart))
+        {
+            close();
+            return false;
+        }
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping)
+        {
+            close();
+            return false;
+        }
+        mpData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        mSize = mpData ? static_cast<size_t>(sz.QuadPart) : 0;
+#else
+        int fd = ::open(fullpath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st{};
+        if ((0 == fstat(fd, &st)) && (0 < st.st_size))
+        {
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != p)
+            {
+                madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                mpData = static_cast<const char*>(p);
+                mSize = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);  // mapping stays valid
+#endif
+        if (!mpData)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() noexcept
+    {
+#ifdef _WIN32
+        if (mpData)
+            UnmapViewOfFile(mpData);
+        if (mMapping)
+            CloseHandle(mMapping);
+        if (INVALID_HANDLE_VALUE != mFile)
+            CloseHandle(mFile);
+        mMapping = nullptr;
+        mFile = INVALID_HANDLE_VALUE;
+#else
+        if (mpData)
+            munmap(const_cast<char*>(mpData), mSize);
+#endif
+        mpData = nullptr;
+        mSize = 0;
+    }
+};
+
+}// namespace xfile
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <charconv>  // from_chars
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+namespace xjson {
+
+/// Pull reader over JSON text, walks objects and arrays in place without building a tree.
+/// Strings are returned as views of their raw text. Malformed input stops all loops and clears isOk().
+class CReader
+{
+    const char* mpPos;
+    const char* mpEnd;
+    bool mIsOk{true};
+
+    void skipWhitespace() noexcept
+    {
+        while ((mpPos < mpEnd) && ((' ' == *mpPos) || ('\n' == *mpPos) || ('\r' == *mpPos) || ('\t' == *mpPos)))
+            ++mpPos;
+    }
+
+    bool fail() noexcept
+    {
+        mIsOk = false;
+        mpPos = mpEnd;
+        return false;
+    }
+
+    bool consume(char c) noexcept
+    {
+        skipWhitespace();
+        if ((mpPos < mpEnd) && (c == *mpPos))
+        {
+            ++mpPos;
+            return true;
+        }
+        return false;
+    }
+
+    // Ends a member or item, false behind the closing bracket
+    bool next(char closing) noexcept
+    {
+        if (consume(closing))
+            return false;
+
+        consume(',');
+        skipWhitespace();
+        return (mpPos < mpEnd) || fail();
+    }
+
+public:
+    explicit CReader(std::string_view text) noexcept :
+        mpPos(text.data()),
+        mpEnd(text.data() + text.size())
+    {}
+
+    bool isOk() const noexcept { return mIsOk; }
+
+    bool beginObject() noexcept { return consume('{') || fail(); }
+    bool beginArray() noexcept { return consume('[') || fail(); }
+
+    // Key of the next member, false behind the closing brace. Read or skip its value before the next call.
+    bool nextKey(std::string_view& rOutKey) noexcept
+    {
+        return next('}') && read(rOutKey) && (consume(':') || fail());
+    }
+
+    // True while the array holds another item. Read or skip it before the next call.
+    bool nextItem() noexcept { return next(']'); }
+
+    // Raw text between the quotes, escapes are left as they are
+    bool read(std::string_view& rOut) noexcept
+    {
+        if (!consume('"'))
+            return fail();
+
+        const char* const pBegin = mpPos;
+        for (; (mpPos < mpEnd) && ('"' != *mpPos); ++mpPos)
+        {
+            if (('\\' == *mpPos) && (mpPos + 1 < mpEnd))
+                ++mpPos;  // escaped quote
+        }
+        if (mpPos >= mpEnd)
+            return fail();
+
+        rOut = { pBegin, (size_t)(mpPos - pBegin) };
+        ++mpPos;
+        return true;
+    }
+
+    bool read(double& rOut) noexcept
+    {
+        skipWhitespace();
+        const auto res = std::from_chars(mpPos, mpEnd, rOut);
+        if (std::errc() != res.ec)
+            return fail();
+
+        mpPos = res.ptr;
+        return true;
+    }
+
+    // Numbers of any format, cut towards zero
+    template<typename T>
+    bool read(T& rOut) noexcept
+    {
+        double val;
+        if (!read(val))
+            return false;
+
+        rOut = static_cast<T>(val);
+        return true;
+    }
+
+    // Steps over one value of any kind, nested ones included
+    bool skipValue() noexcept
+    {
+        size_t depth{};
+        std::string_view str;
+        do
+        {
+            skipWhitespace();
+            if (mpPos >= mpEnd)
+                return fail();
+
+            switch (*mpPos)
+            {
+            case '{':
+            case '[':
+                ++depth;
+                ++mpPos;
+                break;
+
+            case '}':
+            case ']':
+                if (!depth)
+                    return fail();
+                --depth;
+                ++mpPos;
+                break;
+
+            case '"':
+                read(str);
+                break;
+
+            case ',':
+            case ':':
+                if (!depth)
+                    return fail();
+                ++mpPos;
+                break;
+
+            default:  // number, true, false or null
+                while ((mpPos < mpEnd) && (',' != *mpPos) && ('}' != *mpPos) && (']' != *mpPos) &&
+                    (' ' != *mpPos) && ('\n' != *mpPos) && ('\r' != *mpPos) && ('\t' != *mpPos))
+                    ++mpPos;
+                break;
+            }
+        } while (depth && mIsOk);
+        return mIsOk;
+    }
+};
+
+
+// Decodes the escapes of a raw string, \u sequences to UTF-8. Surrogate pairs are not joined.
+inline std::string unescape(std::string_view raw)
+{
+    std::string str;
+    str.reserve(raw.size());
+    for (size_t i=0; i<raw.size(); ++i)
+    {
+        if (('\\' != raw[i]) || (i + 1 >= raw.size()))
+        {
+            str.push_back(raw[i]);
+            continue;
+        }
+
+        switch (raw[++i])
+        {
+        case 'b': str.push_back('\b'); break;
+        case 'f': str.push_back('\f'); break;
+        case 'n': str.push_back('\n'); break;
+        case 'r': str.push_back('\r'); break;
+        case 't': str.push_back('\t'); break;
+        case 'u':
+        {
+            uint32_t cp{};
+            if ((i + 4 < raw.size()) && (raw.data() + i + 5 == std::from_chars(raw.data() + i + 1, raw.data() + i + 5, cp, 16).ptr))
+            {
+                i += 4;
+                if (cp < 0x80)
+                {
+                    str.push_back((char)cp);
+                } else if (cp < 0x800) {
+                    str.push_back((char)(0xC0 | (cp >> 6)));
+                    str.push_back((char)(0x80 | (cp & 0x3F)));
+                } else {
+                    str.push_back((char)(0xE0 | (cp >> 12)));
+                    str.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                    str.push_back((char)(0x80 | (cp & 0x3F)));
+                }
+            }
+            break;
+        }
+        default:  // quote, backslash and slash stand for themselves
+            str.push_back(raw[i]);
+            break;
+        }
+    }
+    return str;
+}
+
+}// namespace xjson
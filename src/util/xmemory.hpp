@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+
+namespace xmemory {
+
+/// Monotonic scratch memory of one conversion, released as a whole when the scope ends.
+/// While alive, scratch() on the creating thread draws from it. Scopes nest, inner ones release first.
+class CScratchScope
+{
+    std::pmr::monotonic_buffer_resource mArena;
+    std::pmr::memory_resource* mpOuter;
+
+    static std::pmr::memory_resource*& current() noexcept
+    {
+        thread_local std::pmr::memory_resource* pRes = nullptr;
+        return pRes;
+    }
+
+public:
+    explicit CScratchScope(size_t initialSize=64*1024) :
+        mArena(initialSize),
+        mpOuter(current())
+    {
+        current() = &mArena;
+    }
+
+    CScratchScope(const CScratchScope&) = delete;
+    CScratchScope& operator=(const CScratchScope&) = delete;
+
+    ~CScratchScope() { current() = mpOuter; }
+
+    // Arena of the innermost scope, the default heap without any
+    static std::pmr::memory_resource* scratch() noexcept
+    {
+        auto pRes = current();
+        return pRes ? pRes : std::pmr::get_default_resource();
+    }
+};
+
+}// namespace xmemory
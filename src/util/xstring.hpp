@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cctype>  // tolower
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -13,12 +16,27 @@ inline bool contains(const std::string& lookInStr, const std::string& lookForStr
     return std::string::npos != lookInStr.find(lookForStr);
 }
 
+// ASCII letters only, e.g. for file extensions
+inline bool endsWithNoCase(std::string_view str, std::string_view suffix) noexcept
+{
+    if (str.size() < suffix.size())
+        return false;
+
+    str.remove_prefix(str.size() - suffix.size());
+    for (size_t i=0; i<suffix.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(str[i])) != std::tolower(static_cast<unsigned char>(suffix[i])))
+            return false;
+    }
+    return true;
+}
+
 inline bool isEmptyOrWhitespace(const std::string* const pStr)
 {
     return pStr ? (pStr->empty() || std::string::npos == pStr->find_first_not_of(WHITESPACE)) : true;
 }
 
-inline bool trySplit(const std::string& rIn, std::vector<std::string>& _rOut, char delim)
+inline bool trySplit(std::string_view rIn, std::vector<std::string>& _rOut, char delim)
 {
     if (rIn.empty())
         return false;
@@ -33,7 +51,7 @@ inline bool trySplit(const std::string& rIn, std::vector<std::string>& _rOut, ch
         epos = rIn.find(delim, spos);
         if (spos < rIn.length() && (epos>spos))  // no empty splits
         {
-            _rOut.push_back(rIn.substr(spos, epos-spos));  // epos may exceed strlen
+            _rOut.emplace_back(rIn.substr(spos, epos-spos));  // epos may exceed strlen
             // added element should not be empty, but can be whitespace
         }
     } while (epos < rIn.length()-1);
@@ -41,6 +59,60 @@ inline bool trySplit(const std::string& rIn, std::vector<std::string>& _rOut, ch
     return (1 == _rOut.size()) ? false : !_rOut.empty();
 }
 
+/// Fixed capacity list of views into a split string. Never allocates.
+template<size_t N>
+class fields
+{
+    static_assert(N > 0, "Needs room for at least one field");
+
+    std::array<std::string_view, N> mItems{};
+    size_t mCount{};
+
+public:
+    using const_iterator = typename std::array<std::string_view, N>::const_iterator;
+
+    static constexpr size_t capacity() { return N; }
+    size_t size() const { return mCount; }
+    bool empty() const { return !mCount; }
+    bool full() const { return N == mCount; }
+    void clear() { mCount = 0; }
+    void push_back(std::string_view str) { mItems[mCount++] = str; }  // check full() before
+
+    const std::string_view& operator[](size_t i) const { return mItems[i]; }
+    const std::string_view& front() const { return mItems[0]; }
+    const std::string_view& back() const { return mItems[mCount - 1]; }
+    const_iterator cbegin() const { return mItems.cbegin(); }
+    const_iterator cend() const { return mItems.cbegin() + mCount; }
+};
+
+// Same rules as the vector overload, but the fields are views into rIn.
+// If there are more fields than capacity, the last one holds the unsplit remainder.
+template<size_t N>
+inline bool trySplit(std::string_view rIn, fields<N>& _rOut, char delim)
+{
+    if (rIn.empty())
+        return false;
+
+    _rOut.clear();
+
+    size_t spos, epos;
+    epos = 0;
+    while (std::string_view::npos != (spos = rIn.find_first_not_of(delim, epos)))  // skips continuous delimiters
+    {
+        if (N - 1 == _rOut.size())
+        {// no room to split further
+            _rOut.push_back(rIn.substr(spos));
+            break;
+        }
+        epos = rIn.find(delim, spos);
+        _rOut.push_back(rIn.substr(spos, epos-spos));  // epos may exceed strlen
+        if (std::string_view::npos == epos)
+            break;
+    }
+
+    return (1 == _rOut.size()) ? false : !_rOut.empty();
+}
+
 inline std::string trim(const std::string& str, const char* trimChars  = WHITESPACE)
 {
     size_t spos, epos;
@@ -51,6 +123,40 @@ inline std::string trim(const std::string& str, const char* trimChars  = WHITESP
     (epos >= spos)) ? str.substr(spos, epos-spos+1) : std::string("");
 }
 
+inline std::string_view trimView(std::string_view str, const char* trimChars = WHITESPACE)
+{
+    size_t spos = str.find_first_not_of(trimChars);
+    if (std::string_view::npos == spos)
+        return {};
+
+    return str.substr(spos, str.find_last_not_of(trimChars) - spos + 1);
+}
+
+// '*' matches any run of characters, '?' any single one. Iterative, backtracks to the last star only.
+inline bool matchWildcard(std::string_view str, std::string_view pattern) noexcept
+{
+    size_t s = 0, p = 0;
+    size_t starP = std::string_view::npos, starS = 0;
+    while (s < str.length())
+    {
+        if ((p < pattern.length()) && (('?' == pattern[p]) || (str[s] == pattern[p])))
+        {
+            ++s; ++p;
+        } else if ((p < pattern.length()) && ('*' == pattern[p])) {
+            starP = p++;
+            starS = s;
+        } else if (std::string_view::npos != starP) {
+            p = starP + 1;
+            s = ++starS;
+        } else {
+            return false;
+        }
+    }
+    while ((p < pattern.length()) && ('*' == pattern[p]))
+        ++p;
+    return p == pattern.length();
+}
+
 inline void filter(std::string& str, std::string filterChars)
 {
     for (auto&& c : str)
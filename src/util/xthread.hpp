@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>  // max
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace xthread {
+
+/// Fixed number of threads working off a shared task queue.
+class CWorkerPool
+{
+    std::vector<std::thread> mWorkers;
+    std::deque<std::function<void()>> mTasks;
+    std::mutex mMtx;
+    std::condition_variable mCvTask;
+    std::condition_variable mCvIdle;
+    size_t mBusy{};
+    bool mStop{};
+
+    void work()
+    {
+        std::function<void()> task;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lk(mMtx);
+                mCvTask.wait(lk, [this] { return mStop || !mTasks.empty(); });
+                if (mTasks.empty())
+                    return;  // stopped and drained
+
+                task = std::move(mTasks.front());
+                mTasks.pop_front();
+                ++mBusy;
+            }
+            task();  // tasks must not throw
+            {
+                std::lock_guard<std::mutex> lk(mMtx);
+                --mBusy;
+                if (mTasks.empty() && !mBusy)
+                    mCvIdle.notify_all();
+            }
+        }
+    }
+
+public:
+    // Zero threads picks the number of hardware threads
+    explicit CWorkerPool(unsigned threads=0)
+    {
+        if (!threads)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        mWorkers.reserve(threads);
+        for (unsigned i=0; i<threads; ++i)
+        {
+            mWorkers.emplace_back(&CWorkerPool::work, this);
+        }
+    }
+
+    CWorkerPool(const CWorkerPool&) = delete;
+    CWorkerPool& operator=(const CWorkerPool&) = delete;
+
+    // Finishes queued tasks before joining
+    ~CWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mMtx);
+            mStop = true;
+        }
+        mCvTask.notify_all();
+        for (auto&& th : mWorkers)
+        {
+            th.join();
+        }
+    }
+
+    size_t size() const { return mWorkers.size(); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mMtx);
+            mTasks.push_back(std::move(task));
+        }
+        mCvTask.notify_one();
+    }
+
+    // Blocks until the queue is empty and no task is running
+    void wait()
+    {
+        std::unique_lock<std::mutex> lk(mMtx);
+        mCvIdle.wait(lk, [this] { return mTasks.empty() && !mBusy; });
+    }
+};
+
+}// namespace xthread
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>  // hash
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace xtrace {
+
+/// Process wide recorder of timed scopes and counters, saved in Chrome trace-event format.
+/// Disabled until enable() is called, recording then costs one relaxed load per scope or counter.
+class CTracer
+{
+public:
+    using clock_t = std::chrono::steady_clock;
+
+private:
+    struct RecordT
+    {
+        const char* Name;  // string literal
+        uint64_t    Tid;
+        int64_t     Start_us;
+        int64_t     Value;  // duration or counter total
+        bool        IsCounter;
+    };
+
+    std::atomic<bool> mIsEnabled{};
+    clock_t::time_point mOrigin{clock_t::now()};
+    std::vector<RecordT> mRecords;
+    std::unordered_map<std::string, int64_t> mTotals;  // by counter name
+    std::mutex mMtx;
+
+    static uint64_t threadId() { return std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xFFFFFFu; }
+
+public:
+    static CTracer& instance()
+    {
+        static CTracer tracer;
+        return tracer;
+    }
+
+    bool isEnabled() const noexcept { return mIsEnabled.load(std::memory_order_relaxed); }
+    void enable() noexcept { mIsEnabled.store(true, std::memory_order_relaxed); }
+
+    int64_t since(clock_t::time_point tp) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(tp - mOrigin).count();
+    }
+
+    // Called from scope destructors, a record that can not be stored is dropped
+    void addScope(const char* name, clock_t::time_point start, clock_t::time_point stop) noexcept
+    {
+        try
+        {
+            const auto ts = since(start);
+            const RecordT rec{ name, threadId(), ts, since(stop) - ts, false };
+            std::lock_guard<std::mutex> lk(mMtx);
+            mRecords.push_back(rec);
+        } catch (...) {}  // out of memory or lock failure
+    }
+
+    // Counters are shown as running totals
+    void addCount(const char* name, int64_t value)
+    {
+        const auto tid = threadId();
+        const auto now = since(clock_t::now());
+        std::lock_guard<std::mutex> lk(mMtx);
+        mRecords.push_back({ name, tid, now, mTotals[name] += value, true });
+    }
+
+    // Chrome trace-event JSON, loadable by chrome://tracing and Perfetto
+    bool save(const std::string& fullpath)
+    {
+        std::ofstream fs(fullpath);
+        if (!fs.is_open())
+            return false;
+
+        std::lock_guard<std::mutex> lk(mMtx);
+        fs << "{\"traceEvents\":[";
+        for (size_t i=0; i<mRecords.size(); ++i)
+        {
+            const auto& rec = mRecords[i];
+            fs << (i ? ",\n" : "\n") << R"({"name":")" << rec.Name
+                << R"(","pid":1,"tid":)" << rec.Tid
+                << R"(,"ts":)" << rec.Start_us;
+            if (rec.IsCounter)
+                fs << R"(,"ph":"C","args":{"value":)" << rec.Value << "}}";
+            else
+                fs << R"(,"ph":"X","dur":)" << rec.Value << '}';
+        }
+        fs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return fs.good();
+    }
+};
+
+
+/// Times its own lifetime as one stage, if the tracer was enabled when it was created.
+class CScope
+{
+    const char* mName;
+    CTracer::clock_t::time_point mStart{};
+    bool mIsActive;
+
+public:
+    explicit CScope(const char* name) noexcept :
+        mName(name),
+        mIsActive(CTracer::instance().isEnabled())
+    {
+        if (mIsActive)
+            mStart = CTracer::clock_t::now();
+    }
+
+    CScope(const CScope&) = delete;
+    CScope& operator=(const CScope&) = delete;
+
+    ~CScope()
+    {
+        if (mIsActive)
+            CTracer::instance().addScope(mName, mStart, CTracer::clock_t::now());
+    }
+};
+
+
+inline void count(const char* name, int64_t value)
+{
+    if (CTracer::instance().isEnabled())
+        CTracer::instance().addCount(name, value);
+}
+
+}// namespace xtrace
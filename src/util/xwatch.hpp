@@ -0,0 +1,207 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+
+namespace xwatch {
+
+/// Reports files written, deleted or moved in or out below a folder. Callers tell removals by the file being gone,
+/// a folder gone reports its own path. Folders created or moved in later are followed and report the files in them.
+/// Uses inotify on Linux and ReadDirectoryChangesW on Windows.
+class CDirWatcher
+{
+#ifdef _WIN32
+    HANDLE mDir{INVALID_HANDLE_VALUE};
+    std::filesystem::path mRoot;
+    alignas(DWORD) char mBuff[16 * 1024];
+#else
+    int mFd{-1};
+    std::unordered_map<int, std::filesystem::path> mDirs;  // by watch descriptor
+    alignas(inotify_event) char mBuff[16 * 1024];
+#endif
+
+public:
+    CDirWatcher() = default;
+    CDirWatcher(const CDirWatcher&) = delete;
+    CDirWatcher& operator=(const CDirWatcher&) = delete;
+    ~CDirWatcher() { close(); }
+
+    // Watches root and all folders below it
+    bool open(const std::string& root)
+    {
+        close();
+        std::error_code ec;
+        if (!std::filesystem::is_directory(root, ec))
+            return false;
+#ifdef _WIN32
+        mDir = CreateFileA(root.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        mRoot = root;
+        return INVALID_HANDLE_VALUE != mDir;
+#else
+        mFd = inotify_init1(IN_CLOEXEC);
+        if (mFd < 0)
+            return false;
+
+        if (!add(root))
+        {
+            close();
+            return false;
+        }
+        addTree(root, nullptr);
+        return true;
+#endif
+    }
+
+    // Blocks until files changed, their full paths are appended to rOut. A negative timeout waits forever,
+    // Windows always does. Returns false on timeout or error.
+    // rIsOverflow tells changes were lost, callers have to compare the whole folder again.
+    bool wait(std::vector<std::string>& rOut, bool& rIsOverflow, int timeout_ms=-1)
+    {
+        rIsOverflow = false;
+#ifdef _WIN32
+        (void)timeout_ms;
+        DWORD len{};
+        if ((INVALID_HANDLE_VALUE == mDir) ||
+            !ReadDirectoryChangesW(mDir, mBuff, sizeof(mBuff), TRUE,
+                FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME, &len, nullptr, nullptr))
+            return false;
+
+        if (!len)
+        {// the changes did not fit mBuff
+            rIsOverflow = true;
+            return true;
+        }
+        for (auto p = mBuff;;)
+        {
+            const auto pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+            const auto path = mRoot / std::wstring(pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR));
+            std::error_code ec;
+            if (((FILE_ACTION_ADDED == pInfo->Action) || (FILE_ACTION_RENAMED_NEW_NAME == pInfo->Action)) && std::filesystem::is_directory(path, ec))
+                appendFiles(path, rOut);  // watched by the subtree already
+            else
+                rOut.push_back(path.string());
+            if (!pInfo->NextEntryOffset)
+                break;
+            p += pInfo->NextEntryOffset;
+        }
+        return true;
+#else
+        pollfd pfd{ mFd, POLLIN, 0 };
+        if ((mFd < 0) || (poll(&pfd, 1, timeout_ms) <= 0))
+            return false;
+
+        const auto len = read(mFd, mBuff, sizeof(mBuff));
+        if (len <= 0)
+            return false;
+
+        for (auto p = mBuff; p < mBuff + len;)
+        {
+            const auto pEv = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + pEv->len;
+            if (pEv->mask & IN_Q_OVERFLOW)
+            {
+                rIsOverflow = true;
+                continue;
+            }
+            auto it = mDirs.find(pEv->wd);
+            if (mDirs.end() == it)
+                continue;
+            if (pEv->mask & IN_IGNORED)
+            {// folder deleted or moved away
+                mDirs.erase(it);
+                continue;
+            }
+            if (!pEv->len)
+                continue;
+
+            const auto path = it->second / pEv->name;
+            if (!(pEv->mask & IN_ISDIR))
+            {
+                if (!(pEv->mask & IN_CREATE))
+                    rOut.push_back(path.string());  // created files follow with IN_CLOSE_WRITE
+            } else if (pEv->mask & (IN_CREATE | IN_MOVED_TO)) {
+                addTree(path, &rOut);
+            } else if (pEv->mask & (IN_MOVED_FROM | IN_DELETE)) {
+                rOut.push_back(path.string());  // files moved along are not reported
+            }
+        }
+        return true;
+#endif
+    }
+
+    void close() noexcept
+    {
+#ifdef _WIN32
+        if (INVALID_HANDLE_VALUE != mDir)
+            CloseHandle(mDir);
+        mDir = INVALID_HANDLE_VALUE;
+#else
+        if (0 <= mFd)
+            ::close(mFd);  // drops all watches
+        mFd = -1;
+        mDirs.clear();
+#endif
+    }
+
+private:
+    // Regular files below dir
+    static void appendFiles(const std::filesystem::path& dir, std::vector<std::string>& rOut)
+    {
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, ec), end;
+            !ec && (it != end); it.increment(ec))
+        {
+            if (it->is_regular_file(ec))
+                rOut.push_back(it->path().string());
+        }
+    }
+
+#ifndef _WIN32
+    bool add(const std::filesystem::path& dir)
+    {
+        const int wd = inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_CREATE);
+        if (wd < 0)
+            return false;
+
+        mDirs[wd] = dir;  // a folder moved inside keeps its descriptor
+        return true;
+    }
+
+    // Watches the folders below dir, and appends the files found to pOut. Watching first, files written meanwhile
+    // are reported by both.
+    void addTree(const std::filesystem::path& dir, std::vector<std::string>* pOut)
+    {
+        std::error_code ec;
+        add(dir);
+        for (std::filesystem::recursive_directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, ec), end;
+            !ec && (it != end); it.increment(ec))
+        {
+            if (it->is_directory(ec))
+                add(it->path());
+            else if (pOut && it->is_regular_file(ec))
+                pOut->push_back(it->path().string());
+        }
+    }
+#endif
+};
+
+}// namespace xwatch
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <array>
+#include <cstdint>  // SIZE_MAX
+#include <cstring>  // memcpy
+#include <string>
+#include <string_view>
+#include <utility>  // pair, move
+#include <vector>
+
+
+namespace xzip {
+
+// CRC-32 as used by zip (reflected, polynomial 0xEDB88320)
+inline uint32_t crc32(const char* pData, size_t len, uint32_t crc=0u) noexcept
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i=0; i<256; ++i)
+        {
+            uint32_t c = i;
+            for (int k=0; k<8; ++k)
+            {
+                c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i=0; i<len; ++i)
+    {
+        crc = table[(crc ^ static_cast<uint8_t>(pData[i])) & 0xFFu] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+/// Raw deflate decoder (RFC 1951), whole input to whole output of bounded size.
+class CInflater
+{
+    struct HuffmanT
+    {
+        uint16_t Count[16];  // codes per length
+        uint16_t Symbol[288];  // by code order
+    };
+
+    const uint8_t* mpIn{};
+    size_t   mSize{};
+    size_t   mPos{};
+    uint32_t mBitBuff{};
+    int      mBitCnt{};
+    bool     mIsBad{};
+    std::vector<char>* mpOut{};
+    size_t   mLimit{};  // of the whole output
+
+    int bits(int need) noexcept
+    {
+        uint32_t val = mBitBuff;
+        while (mBitCnt < need)
+        {
+            if (mPos >= mSize)
+            {
+                mIsBad = true;  // out of input
+                return 0;
+            }
+            val |= static_cast<uint32_t>(mpIn[mPos++]) << mBitCnt;
+            mBitCnt += 8;
+        }
+        mBitBuff = val >> need;
+        mBitCnt -= need;
+        return static_cast<int>(val & ((1u << need) - 1u));
+    }
+
+    // Canonical code from lengths. Negative if over-subscribed, positive if incomplete.
+    static int build(HuffmanT& rOut, const uint8_t* lengths, int n) noexcept
+    {
+        uint16_t offs[16];
+        memset(rOut.Count, 0, sizeof(rOut.Count));
+        for (int sym=0; sym<n; ++sym)
+        {
+            ++rOut.Count[lengths[sym]];
+        }
+        if (rOut.Count[0] == n)
+            return 0;  // no codes
+
+        int left = 1;
+        for (int len=1; len<16; ++len)
+        {
+            left <<= 1;
+            left -= rOut.Count[len];
+            if (left < 0)
+                return left;
+        }
+        offs[1] = 0;
+        for (int len=1; len<15; ++len)
+        {
+            offs[len + 1] = offs[len] + rOut.Count[len];
+        }
+        for (int sym=0; sym<n; ++sym)
+        {
+            if (lengths[sym])
+                rOut.Symbol[offs[lengths[sym]]++] = static_cast<uint16_t>(sym);
+        }
+        return left;
+    }
+
+    int decode(const HuffmanT& h) noexcept
+    {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int len=1; len<16; ++len)
+        {
+            code |= bits(1);
+            const int cnt = h.Count[len];
+            if (code - cnt < first)
+                return h.Symbol[index + (code - first)];
+
+            index += cnt;
+            first += cnt;
+            first <<= 1;
+            code <<= 1;
+        }
+        mIsBad = true;  // no such code
+        return 0;
+    }
+
+    bool stored() noexcept
+    {
+        mBitBuff = 0;  // rest of current byte is padding
+        mBitCnt = 0;
+        if (mPos + 4 > mSize)
+            return false;
+
+        const unsigned len = mpIn[mPos] | (mpIn[mPos + 1] << 8);
+        const unsigned nlen = mpIn[mPos + 2] | (mpIn[mPos + 3] << 8);
+        mPos += 4;
+        if ((len != (~nlen & 0xFFFFu)) || (mPos + len > mSize) || (len > mLimit - mpOut->size()))
+            return false;
+
+        mpOut->insert(mpOut->end(), mpIn + mPos, mpIn + mPos + len);
+        mPos += len;
+        return true;
+    }
+
+    bool codes(const HuffmanT& lencode, const HuffmanT& distcode)
+    {
+        static const uint16_t LEN_BASE[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t LEN_EXTRA[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t DIST_BASE[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t DIST_EXTRA[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        int sym;
+        do
+        {
+            sym = decode(lencode);
+            if (mIsBad)
+                return false;
+
+            if (sym < 256)
+            {
+                if (mpOut->size() >= mLimit)
+                    return false;
+                mpOut->push_back(static_cast<char>(sym));
+            } else if (sym > 256) {
+                sym -= 257;
+                if (sym >= 29)
+                    return false;
+
+                const size_t len = LEN_BASE[sym] + bits(LEN_EXTRA[sym]);
+                sym = decode(distcode);
+                if (mIsBad || (sym >= 30))
+                    return false;
+
+                const size_t dist = DIST_BASE[sym] + bits(DIST_EXTRA[sym]);
+                if (mIsBad || (dist > mpOut->size()) || (len > mLimit - mpOut->size()))
+                    return false;
+
+                for (size_t i=0; i<len; ++i)
+                {// may overlap, byte by byte
+                    mpOut->push_back((*mpOut)[mpOut->size() - dist]);
+                }
+            }
+        } while (256 != sym);
+        return true;
+    }
+
+    bool fixed()
+    {
+        static const auto tables = [] {
+            std::pair<HuffmanT, HuffmanT> t;
+            uint8_t lengths[288];
+            int sym = 0;
+            for (; sym<144; ++sym) lengths[sym] = 8;
+            for (; sym<256; ++sym) lengths[sym] = 9;
+            for (; sym<280; ++sym) lengths[sym] = 7;
+            for (; sym<288; ++sym) lengths[sym] = 8;
+            build(t.first, lengths, 288);
+            for (sym=0; sym<30; ++sym) lengths[sym] = 5;
+            build(t.second, lengths, 30);
+            return t;
+        }();
+        return codes(tables.first, tables.second);
+    }
+
+    bool dynamic()
+    {
+        static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        uint8_t lengths[320];
+        HuffmanT lencode;
+        HuffmanT distcode;
+
+        const int nlen = bits(5) + 257;
+        const int ndist = bits(5) + 1;
+        const int ncode = bits(4) + 4;
+        if (mIsBad || (nlen > 286) || (ndist > 30))
+            return false;
+
+        int index = 0;
+        for (; index<ncode; ++index)
+        {
+            lengths[ORDER[index]] = static_cast<uint8_t>(bits(3));
+        }
+        for (; index<19; ++index)
+        {
+            lengths[ORDER[index]] = 0;
+        }
+        if (mIsBad || (0 != build(lencode, lengths, 19)))
+            return false;  // code lengths code must be complete
+
+        index = 0;
+        while (index < nlen + ndist)
+        {
+            int sym = decode(lencode);
+            if (mIsBad)
+                return false;
+
+            if (sym < 16)
+            {
+                lengths[index++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            uint8_t len = 0;
+            if (16 == sym)
+            {
+                if (!index)
+                    return false;  // nothing to repeat
+                len = lengths[index - 1];
+                sym = 3 + bits(2);
+            } else if (17 == sym) {
+                sym = 3 + bits(3);
+            } else {
+                sym = 11 + bits(7);
+            }
+            if (mIsBad || (index + sym > nlen + ndist))
+                return false;
+
+            while (sym--)
+            {
+                lengths[index++] = len;
+            }
+        }
+        if (!lengths[256])
+            return false;  // no end of block code
+
+        int err = build(lencode, lengths, nlen);
+        if ((err < 0) || ((err > 0) && (nlen - lencode.Count[0] != 1)))
+            return false;  // only a single code may be incomplete
+
+        err = build(distcode, lengths + nlen, ndist);
+        if ((err < 0) || ((err > 0) && (ndist - distcode.Count[0] != 1)))
+            return false;
+
+        return codes(lencode, distcode);
+    }
+
+public:
+    // Appends the decoded data to rOut. Fails as soon as more than maxSize bytes would be appended.
+    bool inflate(std::string_view in, std::vector<char>& rOut, size_t maxSize=SIZE_MAX)
+    {
+        mpIn = reinterpret_cast<const uint8_t*>(in.data());
+        mSize = in.size();
+        mPos = 0;
+        mBitBuff = 0;
+        mBitCnt = 0;
+        mIsBad = false;
+        mpOut = &rOut;
+        mLimit = (maxSize > SIZE_MAX - rOut.size()) ? SIZE_MAX : rOut.size() + maxSize;
+
+        int last;
+        bool ok;
+        do
+        {
+            last = bits(1);
+            switch (bits(2))
+            {
+            case 0:
+                ok = stored();
+                break;
+
+            case 1:
+                ok = fixed();
+                break;
+
+            case 2:
+                ok = dynamic();
+                break;
+
+            default:
+                ok = false;
+                break;
+            }
+        } while (ok && !mIsBad && !last);
+        return ok && !mIsBad;
+    }
+};
+
+
+/// Entry of a zip central directory.
+struct EntryT
+{
+    std::string Name;  // with folders, '/' separated
+    uint16_t Method{};  // 0 stored, 8 deflate
+    uint16_t Flags{};
+    uint32_t Crc{};
+    uint32_t PackedSize{};
+    uint32_t Size{};
+    uint32_t HeaderOffset{};  // of the local header
+};
+
+
+/// Reads entries of a zip archive held in memory, e.g. a mapped file. Stored and deflate only, no zip64.
+class CZipReader
+{
+    std::string_view mArchive;
+    std::vector<EntryT> mEntries;
+
+    static uint16_t u16(const char* p) noexcept { return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8)); }
+    static uint32_t u32(const char* p) noexcept { return u16(p) | (static_cast<uint32_t>(u16(p + 2)) << 16); }
+
+public:
+    static const uint32_t SIG_LOCAL = 0x04034b50u;
+    static const uint32_t SIG_CENTRAL = 0x02014b50u;
+    static const uint32_t SIG_END = 0x06054b50u;
+    static const uint32_t MAX_ENTRY_SIZE = 256u << 20;  // far above any beatmap or song
+
+    // The archive bytes must outlive the reader
+    bool open(std::string_view archive)
+    {
+        mArchive = archive;
+        mEntries.clear();
+        if (archive.size() < 22)
+            return false;
+
+        // End record is last, followed by a comment of up to 64k
+        const char* p = archive.data();
+        size_t pos = archive.size() - 22;
+        const size_t stop = (pos > 0xFFFFu) ? pos - 0xFFFFu : 0;
+        while (SIG_END != u32(p + pos))
+        {
+            if (pos == stop)
+                return false;
+            --pos;
+        }
+        const uint16_t count = u16(p + pos + 10);
+        const uint32_t cdSize = u32(p + pos + 12);
+        size_t cd = u32(p + pos + 16);
+        if ((0xFFFFFFFFu == cd) || (cd + cdSize > pos))
+            return false;  // zip64 or damaged
+
+        mEntries.reserve(count);
+        for (uint16_t i=0; i<count; ++i)
+        {
+            if ((cd + 46 > pos) || (SIG_CENTRAL != u32(p + cd)))
+                return false;
+
+            EntryT en;
+            en.Flags = u16(p + cd + 8);
+            en.Method = u16(p + cd + 10);
+            en.Crc = u32(p + cd + 16);
+            en.PackedSize = u32(p + cd + 20);
+            en.Size = u32(p + cd + 24);
+            const size_t nameLen = u16(p + cd + 28);
+            const size_t skipLen = static_cast<size_t>(u16(p + cd + 30)) + u16(p + cd + 32);  // extra and comment
+            en.HeaderOffset = u32(p + cd + 42);
+            if (cd + 46 + nameLen > pos)
+                return false;
+
+            en.Name.assign(p + cd + 46, nameLen);
+            mEntries.push_back(std::move(en));
+            cd += 46 + nameLen + skipLen;
+        }
+        return true;
+    }
+
+    const std::vector<EntryT>& entries() const { return mEntries; }
+
+    // Appends the entry content to rOut, checked against its CRC. Entries stating more than maxSize bytes are
+    // rejected, and decoding stops at the stated size.
+    bool extract(const EntryT& en, std::vector<char>& rOut, size_t maxSize=MAX_ENTRY_SIZE) const
+    {
+        const char* p = mArchive.data();
+        const size_t pos = en.HeaderOffset;
+        if ((en.Size > maxSize) || (en.Flags & 0x1u) || (pos + 30 > mArchive.size()) || (SIG_LOCAL != u32(p + pos)))
+            return false;  // too large, encrypted or damaged
+
+        const size_t data = pos + 30 + u16(p + pos + 26) + u16(p + pos + 28);  // local name and extra may differ
+        if (data + en.PackedSize > mArchive.size())
+            return false;
+
+        const size_t first = rOut.size();
+        const std::string_view packed(p + data, en.PackedSize);
+        rOut.reserve(first + en.Size);
+        switch (en.Method)
+        {
+        case 0:
+            if (en.PackedSize != en.Size)
+                return false;
+            rOut.insert(rOut.end(), packed.cbegin(), packed.cend());
+            break;
+
+        case 8:
+            if (!CInflater().inflate(packed, rOut, en.Size))
+                return false;
+            break;
+
+        default:
+            return false;
+        }
+        return (rOut.size() - first == en.Size) && (en.Crc == crc32(rOut.data() + first, en.Size));
+    }
+};
+
+}// namespace xzip